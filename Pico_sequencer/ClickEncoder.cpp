@@ -44,10 +44,10 @@
 // ----------------------------------------------------------------------------
 
 ClickEncoder::ClickEncoder(uint8_t A, uint8_t B, uint8_t BTN, uint8_t stepsPerNotch, bool active)
-  : doubleClickEnabled(true), accelerationEnabled(true),
-    delta(0), last(0), acceleration(0),
-    button(Open), steps(stepsPerNotch),
-    pinA(A), pinB(B), pinBTN(BTN), pinsActive(active)
+  : pinA(A), pinB(B), pinBTN(BTN), pinsActive(active),
+    delta(0), last(0), steps(stepsPerNotch),
+    acceleration(0), accelerationEnabled(true),
+    button(Open), doubleClickEnabled(true)
 {
   uint8_t configType = (pinsActive == LOW) ? INPUT_PULLUP : INPUT;
   pinMode(pinA, configType);
@@ -65,43 +65,44 @@ ClickEncoder::ClickEncoder(uint8_t A, uint8_t B, uint8_t BTN, uint8_t stepsPerNo
 
 // ----------------------------------------------------------------------------
 // call this every 1 millisecond via timer ISR
+// reads the pins directly. encoders that are sampled some other way (eg the PIO mux scanner)
+// call decode() with each sample and tick() every millisecond instead
 //
 void ClickEncoder::service(void)
 {
-  bool moved = false;
-  unsigned long now = millis();
-
-  if (accelerationEnabled) { // decelerate every tick
-    acceleration -= ENC_ACCEL_DEC;
-    if (acceleration & 0x8000) { // handle overflow of MSB is set
-      acceleration = 0;
-    }
-  }
+  decode(digitalRead(pinA) == pinsActive, digitalRead(pinB) == pinsActive);
+  tick(digitalRead(pinBTN) == pinsActive);
+}
 
+// ----------------------------------------------------------------------------
+// decode one sample of the A and B inputs - true means active
+// can be called faster than 1ms so fast spins don't miss steps
+//
+void ClickEncoder::decode(bool a, bool b)
+{
 #if ENC_DECODER == ENC_FLAKY
   last = (last << 2) & 0x0F;
 
-  if (digitalRead(pinA) == pinsActive) {
+  if (a) {
     last |= 2;
   }
 
-  if (digitalRead(pinB) == pinsActive) {
+  if (b) {
     last |= 1;
   }
 
-  uint8_t tbl = pgm_read_byte(&table[last]);
+  int8_t tbl = pgm_read_byte(&table[last]);
   if (tbl) {
-    delta += tbl;
-    moved = true;
+    move(tbl);
   }
 #elif ENC_DECODER == ENC_NORMAL
   int8_t curr = 0;
 
-  if (digitalRead(pinA) == pinsActive) {
+  if (a) {
     curr = 3;
   }
 
-  if (digitalRead(pinB) == pinsActive) {
+  if (b) {
     curr ^= 1;
   }
 
@@ -109,29 +110,65 @@ void ClickEncoder::service(void)
 
   if (diff & 1) {            // bit 0 = step
     last = curr;
-    delta += (diff & 2) - 1; // bit 1 = direction (+/-)
-    moved = true;
+    move((diff & 2) - 1); // bit 1 = direction (+/-)
   }
 #else
 # error "Error: define ENC_DECODER to ENC_NORMAL or ENC_FLAKY"
 #endif
+}
 
-  if (accelerationEnabled && moved) {
+// ----------------------------------------------------------------------------
+// the encoder moved one step in direction dir. used by decode() or by a decoder that handles several encoders at once
+//
+void ClickEncoder::move(int8_t dir)
+{
+  delta += dir;
+  if (accelerationEnabled) {
     // increment accelerator if encoder has been moved
     if (acceleration <= (ENC_ACCEL_TOP - ENC_ACCEL_INC)) {
       acceleration += ENC_ACCEL_INC;
     }
   }
+}
 
-  // handle button
-  //
+// ----------------------------------------------------------------------------
+// acceleration decay - call every 1 millisecond. returns true while there is acceleration left
+//
+bool ClickEncoder::decay(void)
+{
+  if (accelerationEnabled) { // decelerate every tick
+    acceleration -= ENC_ACCEL_DEC;
+    if (acceleration & 0x8000) { // handle overflow of MSB is set
+      acceleration = 0;
+    }
+  }
+  return acceleration != 0;
+}
+
+// ----------------------------------------------------------------------------
+// call every 1 millisecond - acceleration decay and button handling
+// btn is true when the button is down
+//
+void ClickEncoder::tick(bool btn)
+{
+  decay();
+  buttontick(btn);
+}
+
+// ----------------------------------------------------------------------------
+// button handling - call every 1 millisecond. btn is true when the button is down
+//
+void ClickEncoder::buttontick(bool btn)
+{
 #ifndef WITHOUT_BUTTON
+  unsigned long now = millis();
+
   if (pinBTN > 0 // check button only, if a pin has been provided
       && (now - lastButtonCheck) >= ENC_BUTTONINTERVAL) // checking button is sufficient every 10-30ms
   {
     lastButtonCheck = now;
 
-    if (digitalRead(pinBTN) == pinsActive) { // key is down
+    if (btn) { // key is down
       button=Closed;
       keyDownTicks++;
       if (keyDownTicks > (ENC_HOLDTIME / ENC_BUTTONINTERVAL)) {
@@ -139,7 +176,7 @@ void ClickEncoder::service(void)
       }
     }
 
-    if (digitalRead(pinBTN) == !pinsActive) { // key is now up
+    if (!btn) { // key is now up
       if (keyDownTicks /*> ENC_BUTTONINTERVAL*/) {
         if (button == Held) {
           button = Released;
@@ -173,21 +210,41 @@ void ClickEncoder::service(void)
 
 }
 
+// ----------------------------------------------------------------------------
+// true when the button is up and no click is being timed - buttontick() has nothing to do
+//
+bool ClickEncoder::buttonidle(void)
+{
+#ifndef WITHOUT_BUTTON
+  return (keyDownTicks == 0) && (doubleClickTicks == 0);
+#else
+  return true;
+#endif
+}
+
 // ----------------------------------------------------------------------------
 
 int16_t ClickEncoder::getValue(void)
+{
+  noInterrupts();
+  int16_t r = takeValue();
+  interrupts();
+  return r;
+}
+
+// ----------------------------------------------------------------------------
+// same as getValue() for use in the interrupt that decodes the encoder
+//
+int16_t ClickEncoder::takeValue(void)
 {
   int16_t val;
 
-  cli();
   val = delta;
 
   if (steps == 2) delta = val & 1;
   else if (steps == 4) delta = val & 3;
   else delta = 0; // default to 1 step per notch
 
-  sei();
-
   if (steps == 4) val >>= 2;
   if (steps == 2) val >>= 1;
 
@@ -60,7 +60,14 @@ public:
                uint8_t stepsPerNotch = 1, bool active = LOW);
 
   void service(void);
+  void decode(bool a, bool b);
+  void tick(bool btn);
+  void move(int8_t dir);
+  bool decay(void);
+  void buttontick(bool btn);
+  bool buttonidle(void);
   int16_t getValue(void);
+  int16_t takeValue(void);
 
 #ifndef WITHOUT_BUTTON
 public:
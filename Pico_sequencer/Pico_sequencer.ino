@@ -41,7 +41,8 @@
 #include <Wire.h>
 #include <SPI.h>
 #include <Adafruit_GFX.h>
-#include <SH1106.h>
+#include "oled.h"  // SH1106 driver with dirty region updates
+#include "timing.h"  // timing statistics
 //#include <Adafruit_S6D02A1.h> // Hardware-specific library for S6D02A1
 #include <Adafruit_TinyUSB.h>
 #include <MIDI.h>
@@ -76,20 +77,17 @@ bool menumode=0;  // when true we are in the text menu system
 int16_t UI_state=NOTE_DRAW; // initial UI state
 
 int16_t current_track=0; // track we are editing
-int16_t MIDIchannel[NTRACKS] = {1,2,3,4}; // midi channel to use for sequencer notes
-int16_t trackenabled[NTRACKS] = {1,0,0,0}; // 1 if track on is 1, 0 if off
-int16_t CCchannel[NTRACKS] = {1,2,3,4}; // midi channel to use for CCs
-int16_t mod_enabled[NTRACKS] = {0,0,0,0}; // 1 if mod sequencer for track is on, 0 if off
 
 #define DISPLAY_BLANK_MS 120*1000  // display blanking time
 int32_t displaytimer ; // display blanking timer
+#define UI_FPS 30  // screen updates per second. inputs are handled on every loop() pass, drawing goes out at this rate
+uint32_t nextframe;  // time of the next screen update in us
+bool frametick;  // true on loop() passes that update the screen
+int16_t blankedstate;  // UI state when the display was blanked
 
 #define TEMPO    120
 #define PPQN 24  // clocks per quarter note
 int16_t bpm = TEMPO;
-int32_t lastMIDIclock; // timestamp of last MIDI clock
-int16_t MIDIclocks=PPQN*2; // midi clock counter
-int16_t MIDIsync = 16;  // number of clocks required to sync BPM
 int16_t useMIDIclock = 0; // true if we are using MIDI clock
 
 enum CONTROLSTATES {IDLE,STARTUP,RUNNING,RUNJUSTSYNCED,SHUTDOWN}; // control state machine states
@@ -176,7 +174,7 @@ ClickEncoder menuenc(MENU_ENCA_IN,MENU_ENCB_IN,MENU_ENCSW_IN,ENCDIVIDE); // menu
 #define TFT_CS     17
 #define TFT_RESET  20
 
-Adafruit_SH1106 display(OLED_DC, OLED_RESET, OLED_CS);
+OLED_SH1106 display(OLED_DC, OLED_RESET, OLED_CS);
 //Adafruit_S6D02A1 display = Adafruit_S6D02A1(TFT_CS, TFT_DC, TFT_RESET);
 
 
@@ -194,21 +192,15 @@ MIDI_CREATE_INSTANCE(Adafruit_USBD_MIDI, usb_midi, MidiUSB);
 
 
 // timer interrupt handler
-// scans thru the multiplexed encoders and handles the menu encoder
+// handles the menu encoder
 // debounces the buttons
 
 bool TimerHandler0(struct repeating_timer *t)
 {
   (void) t;
+  TIMING_START(start);
 
-  for (int addr=0; addr< NENC;++addr) {
-    digitalWrite(A_MUX_0, addr & 1);
-    digitalWrite(A_MUX_1, addr & 2);
-    digitalWrite(A_MUX_2, addr & 4);
-    digitalWrite(A_MUX_3, addr & 8); 
-    delayMicroseconds(4);         // address settling time 
-    enc[addr].service();    // check the encoder inputs
-  } 
+  // the 16 multiplexed encoders are scanned by PIO - see encscan.h
   menuenc.service(); // handle the menu encoder which is on different port pins
   // debounce the buttons
   if (!(digitalRead(START_STOP_BUTTON))) { 
@@ -227,119 +219,188 @@ bool TimerHandler0(struct repeating_timer *t)
     shift=FALSE;
     shiftbut_count=DEBOUNCE_COUNT;
   }
+  TIMING_END(stat_timerisr,start);
   return true; // required by the timer lib
 }
 
-/*
-*** unfortunately the SPI display drivers do not use a framebuffer so this blanking method will not work
-// turn off the display to avoid burn in but keep the display buffer intact
-// the next call to display.display() will automagically restore what was there plus whatver has been drawn since
-
-void blankdisplay(void) {
-  uint8_t tempbuf[SCREEN_BUFFER_SIZE];
-  uint8_t * buf, * tbuf;
-  buf=display.getBuffer();
-  tbuf= tempbuf;
-  memcpy(tbuf,buf,SCREEN_BUFFER_SIZE); // copy frame buffer to temp storage
-  display.clearDisplay();
-  display.display();  // turn off the OLEDs
-  memcpy(buf,tbuf,SCREEN_BUFFER_SIZE); // restore the old frame buffer
-}
-
-// update the display and reset the display blanking timer
-void displayupdate(){
-  display.display();
-  displaytimer=millis();
-}
-*/
 
 // midi related stuff - after initialization all MIDI stuff runs on core1 for timing accuracy
 // splitting it across both cores causes MidiUSB to hang eventually
 
-// note that the Adafruit stack expects MIDI channel to be 1-16, not 0-15
+// outgoing MIDI is collected in a buffer and handed to TinyUSB with one tud_midi_stream_write() per loop1() pass
+// the stream write packs every message into a USB MIDI packet in the endpoint FIFO and starts one transfer for the lot,
+// so four tracks make a single USB transfer per tick instead of a dozen. usb_midi.write(buf,len) doesn't do that -
+// Adafruit_USBD_MIDI only has a byte write so Print sends the buffer a byte at a time. note offs are sent ahead of note ons
+
+#define MIDIOUT_SIZE 64 // max messages per flush
+
+struct midimsg {
+  uint8_t status,data1,data2;
+};
+
+midimsg midiout[MIDIOUT_SIZE];
+uint8_t midiout_count;
+uint8_t midiout_tx[MIDIOUT_SIZE*3*2];  // bytes for the USB FIFO - whatever didn't fit last time goes first
+uint16_t midiout_txlen;
+uint32_t midiout_flushes;  // number of USB writes
+uint8_t midiout_last;      // messages in the last USB write
+uint8_t midiout_max;       // most messages in one USB write
+uint32_t midiout_overruns; // times the buffer filled up and had to be flushed early
+uint32_t midiout_stalls;   // USB writes the FIFO didn't have room for - the rest went with the next write
+uint32_t midiout_dropped;  // messages thrown away because USB wasn't taking anything eg no host
+
+// send the buffered messages in one USB write, note offs first
+// a note off only moves ahead of note ons that aren't for the same note so we can't turn a note off before it is started
+void midiout_flush(void) {
+  if (midiout_count) {
+    uint16_t len=midiout_txlen;
+    if (len+midiout_count*3 > sizeof(midiout_tx)) midiout_dropped+=midiout_count; // the last writes are still waiting
+    else {
+      for (uint8_t i=0; i<midiout_count; ++i) { // note offs first
+        if ((midiout[i].status & 0xf0) != 0x80) continue;
+        bool blocked=false;
+        for (uint8_t j=0; j<i; ++j) { // is there an earlier note on for this note?
+          if (((midiout[j].status & 0xf0) == 0x90) && ((midiout[j].status & 0x0f) == (midiout[i].status & 0x0f)) && (midiout[j].data1 == midiout[i].data1)) blocked=true;
+        }
+        if (blocked) continue;
+        midiout_tx[len++]=midiout[i].status;
+        midiout_tx[len++]=midiout[i].data1;
+        midiout_tx[len++]=midiout[i].data2;
+        midiout[i].status=0; // sent
+      }
+      for (uint8_t i=0; i<midiout_count; ++i) { // everything else in the order it was generated
+        if (midiout[i].status == 0) continue;
+        midiout_tx[len++]=midiout[i].status;
+        midiout_tx[len++]=midiout[i].data1;
+        midiout_tx[len++]=midiout[i].data2;
+      }
+      midiout_txlen=len;
+      midiout_last=midiout_count;
+      if (midiout_count > midiout_max) midiout_max=midiout_count;
+    }
+    midiout_count=0;
+  }
+  if (midiout_txlen == 0) return;
+  uint32_t sent=tud_midi_stream_write(0,midiout_tx,midiout_txlen); // cable 0
+  ++midiout_flushes;
+  if (sent < midiout_txlen) { // FIFO full - TinyUSB keeps a partly sent message so the rest can just follow next time
+    memmove(midiout_tx,&midiout_tx[sent],midiout_txlen-sent);
+    ++midiout_stalls;
+  }
+  midiout_txlen-=sent;
+}
+
+void midiout_put(uint8_t status, uint8_t data1, uint8_t data2) {
+  if (midiout_count >= MIDIOUT_SIZE) {
+    ++midiout_overruns;
+    midiout_flush();
+  }
+  midiout[midiout_count].status=status;
+  midiout[midiout_count].data1=data1;
+  midiout[midiout_count].data2=data2;
+  ++midiout_count;
+}
+
+// note that MIDI channel is 0-15 here
 void noteOn(byte channel, byte pitch, byte velocity) {
-  MidiUSB.sendNoteOn(pitch,velocity,channel+1);
+  midiout_put(0x90 | (channel & 0x0f),pitch & 0x7f,velocity & 0x7f);
 //  Serial.printf("Noteon ch %d pitch %d vel %d \n",channel,pitch,velocity);
 }
 
 void noteOff(byte channel, byte pitch, byte velocity) {
-  MidiUSB.sendNoteOff(pitch,velocity,channel+1);
+  midiout_put(0x80 | (channel & 0x0f),pitch & 0x7f,velocity & 0x7f);
 //  Serial.printf("Noteoff ch %d pitch %d vel %d \n",channel,pitch,velocity);
 }
 
-// First parameter is the event type (0x0B = control change).
-// Second parameter is the event type, combined with the channel.
-// Third parameter is the control number number (0-119).
-// Fourth parameter is the control value (0-127).
-
+// channel 0-15, control number 0-119, control value 0-127
 void controlChange(byte channel, byte control, byte value) {
-  MidiUSB.sendControlChange(control,value,channel+1);
+  midiout_put(0xb0 | (channel & 0x0f),control & 0x7f,value & 0x7f);
 }
 
 
 // set up as include files because I'm too lazy to create proper header and .cpp files
+#include "spscqueue.h" // inter core message queues
+#include "encscan.h"  // has to come after encoder objects creation
 #include "scales.h"   //
+#include "events.h"  // has to come after midi note on/off
 #include "seq.h"   // has to come after midi note on/of
+#include "clock.h"  // has to come after seq.h
+#include "cycle.h"  // pattern period and cycle cache
+#include "presets.h"  // preset storage in flash
 #include "menusystem.h"  // has to come after display and encoder objects creation
 #include "graphics.h"   // has to come after display object creation
+#include "render.h"  // offline MIDI file render
+#include "console.h"  // serial commands - has to come last
 
 // these functions are here to avoid forward references. should really do proper include files!
-// there is some risk in processing MIDI start/stop etc on on core 0 since core 1 could also be using MIDI
-// core 0 syncing sequencers while core 1 is doing clocks is a bit dicey
-// idling core 1 when using these resources should work
+// MIDI start/stop/continue are not acted on in the handlers - they are timestamped and queued as transport commands
+// the loop1() state machine picks them up between clock ticks so they can't land in the middle of a tick
+
+enum TRANSPORTCMDS {CMD_START,CMD_STOP,CMD_CONTINUE};
+
+struct transportcmd {
+  uint8_t cmd;   // CMD_START etc
+  uint64_t time; // when the MIDI message was received - us since boot
+};
+
+SPSCQueue<transportcmd,8> transportqueue;
+uint32_t transport_latency; // us between receiving the last transport message and acting on it
+uint32_t transport_latency_max; // worst case
 
 // process MIDI start message - start playing from beginning 
 void handleStart(void){
-  all_notes_off();  // in case notes are already playing
-  sync_sequencers(); // sync all sequencers 
-  MIDIsync=16; // sync BPM again
-  rp2040.idleOtherCore();  // so core 1 doesn't also modify state machine
-  controlstate=RUNNING; // force core 1 to playing state
-  rp2040.resumeOtherCore();
+  transportcmd cmd={CMD_START,time_us_64()};
+  transportqueue.put(cmd);
 }
 
 // process MIDI clock messages
-// count MIDI clocks for a while to get a decent average and then compute BPM from it
-// if external MIDI clock is enabled use it as the master clock
+// clocks are timestamped and passed to the clock follower which also keeps bpm up to date
+// if external MIDI clock is enabled do_clocks() generates the ticks from it
 void handleClock(void){
-  long qn,clockperiod;
-  clockperiod= (long)(((60.0/(float)bpm)/PPQN)*1000); // for call to clocktick(). use calculated BPM which is more stable - MIDI clock has a lot of jitter
-  --MIDIclocks;
-  if (MIDIclocks ==0 ) {
-    MIDIclocks=PPQN*2;
-    qn=millis()-lastMIDIclock;
-    lastMIDIclock=millis();
-    if (MIDIsync >0) --MIDIsync;
-    if (MIDIsync ==0) {
-      if ((qn < 6200) && (qn > 480))  bpm=2*60.0*1000/qn; // check that clock value is between 20 and 240BPM so we don't trash the current bpm
-    }
-//    Serial.printf("%d %d\n",qn,bpm);
-  }
-  if (useMIDIclock) clocktick(clockperiod); 
+  midiclock_in(time_us_64());
 }
 
 // process MIDI stop message - stop playing
 void handleStop(void){
-  all_notes_off();  // so notes don't hang
-  rp2040.idleOtherCore();  // so core 1 doesn't also modify state machine
-  controlstate=IDLE; // put core 1 in idle state machine state
-  rp2040.resumeOtherCore();
+  transportcmd cmd={CMD_STOP,time_us_64()};
+  transportqueue.put(cmd);
 }
 
 // process MIDI continue message - continue playing
 void handleContinue(void){
-  rp2040.idleOtherCore();  // so core 1 doesn't also modify state machine
-  controlstate=RUNNING; // put core 1 in playing state
-  rp2040.resumeOtherCore(); 
+  transportcmd cmd={CMD_CONTINUE,time_us_64()};
+  transportqueue.put(cmd);
+}
+
+// act on a queued transport command - called from loop1() between ticks
+// start and continue put the clock phase at the time the message arrived so the first step isn't skewed
+void do_transport(transportcmd cmd) {
+  switch (cmd.cmd) {
+    case CMD_START:
+      all_notes_off(time_us_64());  // in case notes are already playing
+      sync_sequencers(); // sync all sequencers 
+      clock_start(cmd.time);
+      controlstate=RUNNING;
+      break;
+    case CMD_STOP:
+      all_notes_off(time_us_64());  // so notes don't hang
+      controlstate=IDLE;
+      break;
+    case CMD_CONTINUE:
+      clock_start(cmd.time);
+      controlstate=RUNNING;
+      break;
+  }
+  transport_latency=time_us_64()-cmd.time;
+  if (transport_latency > transport_latency_max) transport_latency_max=transport_latency;
+  TIMING_ADD(stat_translat,transport_latency);
 }
 
 void setup() {
   Serial.begin(115200);
+  pattern_init(); // before core 1 starts using the pattern banks
+  initmenus(); // build the text menus for NTRACKS tracks
 
-  pinMode(A_MUX_0, OUTPUT);    // encoder mux addresses
-  pinMode(A_MUX_1, OUTPUT);  
-  pinMode(A_MUX_2, OUTPUT);  
-  pinMode(A_MUX_3, OUTPUT);
   pinMode(ENCA_IN, INPUT_PULLUP);  // menu encoder and switches
   pinMode(ENCB_IN, INPUT_PULLUP);    
   pinMode(ENCSW_IN, INPUT_PULLUP); 
@@ -353,6 +414,8 @@ void setup() {
 
 
 
+  encscan_init(); // start scanning the step encoders
+
 // set up timer interrupt 
   // Interval in unsigned long microseconds
   if (ITimer.attachInterruptInterval(TIMER_MICROS, TimerHandler0))
@@ -396,6 +459,8 @@ void setup() {
   display.display();
 #endif
   delay(3000);
+  preset_init(); // core 1 is up by now - it has to be for the flash code to park it
+  preset_loadlast(); // carry on with what was saved last
 
   display.fillScreen(BLACK);
   displaytimer=millis(); // reset display blanking timer
@@ -408,15 +473,38 @@ void setup() {
   */
 }
 
+// turn the display back on with what was on it when it was blanked - no redraw needed
+void wakeup(void) {
+  display.wake();
+  encscan_idle(ENCSCAN_IDLE_HZ);
+  UI_state=blankedstate;
+  displaytimer=millis();
+}
+
 // first Pico core does UI etc - not super time critical
 void loop() {
-  
+  TIMING_START(loopstart);
   ClickEncoder::Button button;
   int16_t encvalue,edited_step,edited_val;
 
-  if ((millis()-displaytimer) > DISPLAY_BLANK_MS) {
+  frametick=((int32_t)(micros()-nextframe) >= 0);
+  if (frametick) {
+    nextframe+=1000000/UI_FPS;
+    if ((int32_t)(micros()-nextframe) >= 0) nextframe=micros()+1000000/UI_FPS;  // fell behind - don't try to catch up
+  }
+
+  if ((UI_state != DORMANT) && ((millis()-displaytimer) > DISPLAY_BLANK_MS)) {
+    blankedstate=UI_state; // where to go back to on wake up
     UI_state=DISPLAYOFF;
   } 
+  console_poll(); // serial diagnostics commands
+  preset_poll(); // write a page of a preset being saved
+  cycle_poll(); // menu shows the cache is gone
+  static bool waslocked;
+  if (useMIDIclock && (midiclock_locked != waslocked)) { // report MIDI clock lock changes
+    waslocked=midiclock_locked;
+    Serial.printf("MIDI clock %s %d BPM jitter %d us max %d us\n",waslocked ? "locked" : "unlocked",bpm,(int)midiclock_jitter,(int)midiclock_maxjitter);
+  }
 /*
   if ((millis()-displaytimer) > 500) { // debug printing
     // Serial.printf("step= %d val=%d \n",edited_step,edited_val);
@@ -425,6 +513,7 @@ void loop() {
 */
 
   if (shift && !menumode) { // enter menu mode
+    if (UI_state == DORMANT) wakeup();
     display.fillScreen(BLACK); // erase screen
     topmenuindex=UIpage*NTRACKS+current_track; // link text menus to graphics page
     drawtopmenu(topmenuindex); // repaint the menu for the current sequencer
@@ -455,15 +544,14 @@ void loop() {
       case NOTE_EDIT:
         edited_step=editnotes(&notes[current_track]); // must call by reference to change the structure values
         if (edited_step) {  // show the note index, degree in scale, note name and octave
-          edited_val=notes[current_track].val[edited_step-1];
+          edited_val=notes[current_track].val[editbank][edited_step-1];
           int16_t nameindex=constrain(edited_val+notes[current_track].root,0,127)%12;
           int16_t octave=constrain(edited_val+notes[current_track].root,0,127)/12;
           display.setCursor(6*6,0);  // display which note was changed
           display.printf(":%d %d %s%d    \n",edited_step,edited_val,notenames[nameindex],octave); 
-          display.display();
           displaytimer=millis(); // reset display blanking timer
         }
-        updateindex(notes[current_track]); // show the index on screen
+        if (frametick) updateindex(notes[current_track]); // playhead follows the latest index at the frame rate
         break;
 
       case GATE_DRAW:
@@ -475,13 +563,12 @@ void loop() {
       case GATE_EDIT:
         edited_step=editbars(&gates[current_track]);
         if (edited_step) {  // show the gate value
-          edited_val=gates[current_track].val[edited_step-1];
+          edited_val=gates[current_track].val[editbank][edited_step-1];
           display.setCursor(6*6,0);  
           display.printf(":%d %d%%  ",edited_step,edited_val*100/GATERANGE); 
-          display.display();
           displaytimer=millis(); // reset display blanking timer
         }         
-        updateindex(gates[current_track]); // show the index on screen
+        if (frametick) updateindex(gates[current_track]); // playhead follows the latest index at the frame rate
         break;  
 
       case VELOCITY_DRAW:
@@ -493,13 +580,12 @@ void loop() {
       case VELOCITY_EDIT:
         edited_step=editbars(&velocities[current_track]);
         if (edited_step) {  // show the velocity value
-          edited_val=velocities[current_track].val[edited_step-1];
+          edited_val=velocities[current_track].val[editbank][edited_step-1];
           display.setCursor(10*6,0);  
           display.printf(":%d %d%% ",edited_step,edited_val*100/VELOCITYRANGE); 
-          display.display();
           displaytimer=millis(); // reset display blanking timer
         }  
-        updateindex(velocities[current_track]); // show the index on screen
+        if (frametick) updateindex(velocities[current_track]); // playhead follows the latest index at the frame rate
         break;  
 
       case OFFSET_DRAW:  // offsets added to the note sequence
@@ -511,13 +597,12 @@ void loop() {
       case OFFSET_EDIT:
         edited_step=editnotes(&offsets[current_track]); // must call by reference to change the structure
         if (edited_step) {  // show the note index and degree in scale
-          edited_val=offsets[current_track].val[edited_step-1];
+          edited_val=offsets[current_track].val[editbank][edited_step-1];
           display.setCursor(8*6,0);  // display which note was changed
           display.printf(":%d %d  ",edited_step,edited_val); 
-          display.display();
           displaytimer=millis(); // reset display blanking timer
         }        
-        updateindex(offsets[current_track]); // show the index on screen
+        if (frametick) updateindex(offsets[current_track]); // playhead follows the latest index at the frame rate
         break;
 
       case PROBABILITY_DRAW:
@@ -529,13 +614,12 @@ void loop() {
       case PROBABILITY_EDIT:
         edited_step=editbars(&probability[current_track]);
         if (edited_step) {  // show the probability
-          edited_val=probability[current_track].val[edited_step-1];
+          edited_val=probability[current_track].val[editbank][edited_step-1];
           display.setCursor(13*6,0);  // display which note was changed
           display.printf(":%d %3d%%",edited_step,edited_val*100/PROBABILITYRANGE); 
-          display.display();
           displaytimer=millis(); // reset display blanking timer
         } 
-        updateindex(probability[current_track]); // show the index on screen
+        if (frametick) updateindex(probability[current_track]); // playhead follows the latest index at the frame rate
         break;  
 
       case RATCHET_DRAW:
@@ -547,13 +631,12 @@ void loop() {
       case RATCHET_EDIT:
         edited_step=editbars(&ratchets[current_track]);
         if (edited_step) {  // show the number of ratchets
-          edited_val=ratchets[current_track].val[edited_step-1];
+          edited_val=ratchets[current_track].val[editbank][edited_step-1];
           display.setCursor(10*6,0);  
           display.printf(":%d %d   ",edited_step,edited_val); 
-          display.display();
           displaytimer=millis(); // reset display blanking timer
         }        
-        updateindex(ratchets[current_track]); // show the index on screen
+        if (frametick) updateindex(ratchets[current_track]); // playhead follows the latest index at the frame rate
         break; 
 
       case MOD_DRAW:
@@ -565,23 +648,25 @@ void loop() {
       case MOD_EDIT:
         edited_step=editbars(&mods[current_track]);
         if (edited_step) {  // show the number of ratchets
-          edited_val=mods[current_track].val[edited_step-1];
+          edited_val=mods[current_track].val[editbank][edited_step-1];
           display.setCursor(5*6,0);  
           display.printf(":%d %d   ",edited_step,edited_val); 
-          display.display();
           displaytimer=millis(); // reset display blanking timer
         }        
-        updateindex(mods[current_track]); // show the index on screen
+        if (frametick) updateindex(mods[current_track]); // playhead follows the latest index at the frame rate
         break; 
 
       case DISPLAYOFF:
-        display.fillScreen(BLACK); // protect OLED from burning in
-        display.display(); 
+        encevent_flush(); // step encoders don't edit a blank screen
+        encscan_idle(ENCSCAN_DORMANT_HZ);
+        display.sleep(); // protect OLED from burning in. the framebuffer is kept so wake up is instant
         UI_state=DORMANT;
         break;
       
       case DORMANT:
-        break; // turning menu encoder will start screen up again
+        encevent_flush();
+        __wfi(); // nothing to do till the next interrupt - turning menu encoder will start screen up again
+        break;
 
       default:
         UI_state = UIpages[0];
@@ -590,27 +675,39 @@ void loop() {
     button=menuenc.getButton();
     if (encvalue=menuenc.getValue()) { // scroll thru UI pages
       displaytimer=millis(); // reset display blanking timer
+      if (UI_state == DORMANT) wakeup(); // first turn just turns the screen back on
 //      if (button == ClickEncoder::Closed) { // we are changing tracks
-      if (!digitalRead(MENU_ENCSW_IN)) { // button value not working for some reason
+      else if (!digitalRead(MENU_ENCSW_IN)) { // button value not working for some reason
         current_track+=encvalue;
         current_track=constrain(current_track,0,NTRACKS-1); // handle wrap around
         UI_state=UIpages[UIpage]; // forces redraw
       }
       else {
-        UIpage+=encvalue;  // next page
-        UIpage=constrain(UIpage,0,NUMUIPAGES-1); // handle wrap around
+        int16_t page=UIpage*NSTEPPAGES+steppage+encvalue;  // next page - sequencers longer than the step encoders have several step pages per UI page
+        page=constrain(page,0,NUMUIPAGES*NSTEPPAGES-1); // handle wrap around
+        UIpage=page/NSTEPPAGES;
+        steppage=page%NSTEPPAGES;
         UI_state=UIpages[UIpage];
       //Serial.printf("encvalue= %d UIpage=%d UI_state=%d\n",encvalue,UIpage,UI_state);
       }
     }
   }
-
+  if (frametick) display.display(); // send what was drawn since the last frame - only the changed parts of the screen go out
+#ifdef TIMING_STATS
+  static uint32_t lastframes;
+  if (display.frames != lastframes) { // a frame finished since the last pass
+    lastframes=display.frames;
+    TIMING_ADD(stat_frame,display.frametime);
+  }
+#endif
+  TIMING_END(stat_loop,loopstart);
 }
 
 // second core setup
 // second core dedicated to clock and MIDI processing
 void setup1() {
   delay (1000); // wait for main core to start up peripherals
+  clock_init(); // alarm interrupt has to be set up from core 1
 }
 
 // second core dedicated to clocks and note on/off for timing accuracy - graphical UI causes redraw delays etc
@@ -618,7 +715,13 @@ void setup1() {
 // start button toggles sequencers on and off
 // shift + start button resyncs sequencers
 void loop1(){
+  TIMING_START(loopstart);
+  dispatch_events(time_us_64()); // send any notes that are due
+  midiout_flush(); // anything still waiting for room in the USB FIFO
   MidiUSB.read(); // read any new MIDI messages
+  apply_paramchanges(); // UI edits - drained on every pass so the queue can't fill while we wait for a clock. clocktick() drains it again
+  transportcmd cmd;
+  while (transportqueue.get(cmd)) do_transport(cmd); // MIDI start/stop/continue
   switch (controlstate) {
     case IDLE:
       if (startbutton && shift) sync_sequencers(); // start all sequencers at beginning
@@ -630,18 +733,18 @@ void loop1(){
       }
       break;
     case RUNNING:
-      if (!useMIDIclock) do_clocks(); // clock the sequencers and handle notes
+      do_clocks(time_us_64()); // clock the sequencers and handle notes
       if (startbutton && shift) { // we can sync the sequencers while its running
         sync_sequencers();
         controlstate=RUNJUSTSYNCED;
       }
       if (startbutton && !shift) { // stop the sequencers
-        all_notes_off(); 
+        all_notes_off(time_us_64()); 
         controlstate= SHUTDOWN;
       }
       break;
     case RUNJUSTSYNCED: // just synced, wait for start button release
-      if (!useMIDIclock) do_clocks(); // clock the sequencers and handle notes
+      do_clocks(time_us_64()); // clock the sequencers and handle notes
       if (!startbutton) { // till startbutton is released
         controlstate=RUNNING;
       }
@@ -654,5 +757,10 @@ void loop1(){
     default:
       controlstate=IDLE;
   }
+  midiout_flush(); // anything generated by the state machine eg all notes off
+  TIMING_END(stat_loop1,loopstart);
+  // sleep till the next clock is due instead of spinning
+  if ((controlstate==RUNNING) || (controlstate==RUNJUSTSYNCED)) clock_wait(clock_due());
+  else clock_wait(UINT64_MAX);
 }
 
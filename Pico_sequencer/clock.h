@@ -0,0 +1,169 @@
+// clock related definitions and functions
+// the 24ppqn sequencer clock runs on core 1 from absolute microsecond deadlines on the RP2040 timer
+// each deadline is computed from the previous deadline, not from "now", so timing errors don't accumulate
+// between deadlines core 1 sleeps in WFE and is woken by a hardware alarm instead of spinning on millis()
+
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+
+#define CLOCK_US_PER_BPM (60000000L/PPQN) // tick period in us is CLOCK_US_PER_BPM/bpm
+#define CLOCK_POLL_US 100  // longest time core 1 sleeps before polling MIDI input and the buttons again
+#define CLOCK_LOOKAHEAD_US 1000 // ticks are computed this far ahead of their deadline - the event queue sends their notes on time
+
+uint64_t nextclock;  // deadline of the next clock tick in us since boot
+uint32_t clockfrac;  // remainder of CLOCK_US_PER_BPM/bpm accumulated Bresenham style so the period is exact at any BPM
+int16_t clockbpm;    // BPM the clock period was last computed for
+int clockalarm = -1; // hardware alarm used to wake core 1
+volatile bool clockwake; // set by the alarm interrupt
+
+// hardware alarm interrupt - runs on core 1 because the alarm was set up from core 1
+void clockalarm_irq(uint alarm) {
+  (void) alarm;
+  clockwake=true;
+}
+
+// claim a free hardware alarm for core 1 - must be called from setup1() so the interrupt is enabled on core 1
+void clock_init(void) {
+  clockalarm=hardware_alarm_claim_unused(true);
+  hardware_alarm_set_callback(clockalarm,clockalarm_irq);
+  nextclock=time_us_64();
+}
+
+// run the sequencers for the tick due at ticktime
+void clock_tick(long clockperiod, uint64_t ticktime, uint64_t now) {
+#ifdef TIMING_STATS
+  uint64_t due=ticktime-CLOCK_LOOKAHEAD_US;  // a tick on time runs CLOCK_LOOKAHEAD_US early
+  if (!seq_offline) TIMING_ADD(stat_ticklate,(now > due) ? (uint32_t)(now-due) : 0); // not while simulating
+#else
+  (void) now;
+#endif
+  clocktick(clockperiod,ticktime);
+}
+
+// MIDI clock follower
+// incoming MIDI clocks are timestamped in us and filtered by a second order delay locked loop
+// see Fons Adriaensen, "Using a DLL to filter time" - the loop tracks fractional tempo and phase continuously
+// once locked the internal ticks are generated at the filtered clock times instead of whenever a jittery MIDI clock is read,
+// and a tick may run at most one clock ahead of the MIDI clocks actually received so we never get ahead of the host
+
+#define MIDICLOCK_BW_ACQUIRE 4.0 // loop bandwidth in Hz while locking
+#define MIDICLOCK_BW_LOCKED 1.0  // loop bandwidth in Hz when locked - follows tempo ramps within about a beat
+#define MIDICLOCK_LOCKCOUNT PPQN  // clocks in a row within the lock window required for lock
+#define MIDICLOCK_LOCKWINDOW 8  // lock window is +- period/MIDICLOCK_LOCKWINDOW
+#define MIDICLOCK_TIMEOUT 4  // lose lock after this many periods without a clock
+
+double midiclock_next;    // predicted time of the next MIDI clock in us since boot
+double midiclock_period;  // filtered clock period in us
+uint64_t midiclock_last;  // arrival time of the last MIDI clock
+int16_t midiclock_owed;   // MIDI clocks received minus ticks generated. -1 when we have ticked ahead of the next clock
+int16_t midiclock_inwindow; // consecutive clocks inside the lock window
+volatile bool midiclock_locked; // true when the DLL is locked to the host
+volatile int32_t midiclock_jitter; // average absolute phase error in us
+volatile int32_t midiclock_maxjitter; // largest phase error seen since lock
+
+// restart the DLL from a clock at time t with period p
+void midiclock_reset(uint64_t t, double p) {
+  midiclock_period=p;
+  midiclock_next=(double)t+p;
+  midiclock_inwindow=0;
+  midiclock_locked=false;
+  midiclock_jitter=0;
+  midiclock_maxjitter=0;
+}
+
+// process a MIDI clock that arrived at time t
+void midiclock_in(uint64_t t) {
+  if ((midiclock_last == 0) || ((t-midiclock_last) > MIDICLOCK_TIMEOUT*midiclock_period)) midiclock_reset(t,CLOCK_US_PER_BPM/bpm); // first clock or the host stopped clocking
+  else {
+    double err=(double)t-midiclock_next; // phase error against the prediction
+    if (fabs(err) > midiclock_period/2) midiclock_reset(t,t-midiclock_last); // tempo jumped - restart from the measured period
+    else {
+      double omega=2*PI*(midiclock_locked ? MIDICLOCK_BW_LOCKED : MIDICLOCK_BW_ACQUIRE)*midiclock_period/1000000;
+      midiclock_next+=midiclock_period+sqrt(2)*omega*err;
+      midiclock_period+=omega*omega*err;
+      int32_t abserr=(int32_t)fabs(err);
+      midiclock_jitter+=(abserr-midiclock_jitter)/16;
+      if (abserr < midiclock_period/MIDICLOCK_LOCKWINDOW) {
+        if (midiclock_inwindow < MIDICLOCK_LOCKCOUNT) ++midiclock_inwindow;
+        else if (!midiclock_locked) {
+          midiclock_locked=true;
+          midiclock_maxjitter=0;
+        }
+      }
+      else {
+        midiclock_inwindow=0;
+        midiclock_locked=false;
+      }
+      if (midiclock_locked && (abserr > midiclock_maxjitter)) midiclock_maxjitter=abserr;
+      bpm=constrain((int16_t)(CLOCK_US_PER_BPM/midiclock_period+0.5),20,240); // keeps the BPM in the menus up to date
+    }
+  }
+  midiclock_last=t;
+  if ((controlstate==RUNNING) || (controlstate==RUNJUSTSYNCED)) ++midiclock_owed;
+  else midiclock_owed=0; // clocks don't count till we are playing
+}
+
+// generate ticks from the MIDI clock
+// ticks we owe go out right away, when locked the next tick is scheduled at the predicted clock time
+void do_midiclocks(uint64_t now) {
+  if (midiclock_locked && ((now-midiclock_last) > MIDICLOCK_TIMEOUT*midiclock_period)) midiclock_locked=false; // host stopped sending clock
+  if (midiclock_owed > 0) {
+    --midiclock_owed;
+    clock_tick((long)midiclock_period,now,now);
+  }
+  else if ((midiclock_owed == 0) && midiclock_locked && (now+CLOCK_LOOKAHEAD_US >= midiclock_next)) {
+    --midiclock_owed;
+    clock_tick((long)midiclock_period,(uint64_t)midiclock_next,now);
+  }
+}
+
+// must be called regularly for sequencer to run. now is the current time in us since boot
+// a tick is processed CLOCK_LOOKAHEAD_US before it is due so clocktick() run time doesn't delay the notes
+void do_clocks(uint64_t now) {
+  if (useMIDIclock) {
+    do_midiclocks(now);
+    return;
+  }
+  if (now+CLOCK_LOOKAHEAD_US < nextclock) return;
+  if (bpm != clockbpm) { // tempo changed - restart the fractional accumulator
+    clockbpm=bpm;
+    clockfrac=0;
+  }
+  long clockperiod=CLOCK_US_PER_BPM/clockbpm;
+  if (now > nextclock+clockperiod) nextclock=now; // more than a tick late (just started or stalled) - restart from now instead of bursting ticks
+  uint64_t ticktime=nextclock;
+  nextclock+=clockperiod;
+  clockfrac+=CLOCK_US_PER_BPM % clockbpm;
+  if (clockfrac >= (uint32_t)clockbpm) {
+    clockfrac-=clockbpm;
+    ++nextclock;
+  }
+  clock_tick(clockperiod,ticktime,now);
+}
+
+// start or continue the clock with the first tick at time t
+// with MIDI clock the first tick is the next MIDI clock received
+void clock_start(uint64_t t) {
+  nextclock=t;
+  clockfrac=0;
+  midiclock_owed=0;
+}
+
+// time core 1 has to wake up to process the next clock tick
+uint64_t clock_due(void) {
+  if (useMIDIclock) {
+    if (midiclock_locked && (midiclock_owed == 0)) return (uint64_t)midiclock_next-CLOCK_LOOKAHEAD_US;
+    return UINT64_MAX; // wait for the next MIDI clock
+  }
+  return nextclock-CLOCK_LOOKAHEAD_US;
+}
+
+// sleep core 1 until deadline, the next scheduled MIDI event or the next MIDI poll, whichever comes first
+void clock_wait(uint64_t deadline) {
+  uint64_t poll=time_us_64()+CLOCK_POLL_US;
+  if (deadline > poll) deadline=poll;
+  if (deadline > next_event_time()) deadline=next_event_time();
+  clockwake=false;
+  if (hardware_alarm_set_target(clockalarm,from_us_since_boot(deadline))) return; // deadline already passed
+  while (!clockwake) __wfe();
+}
@@ -0,0 +1,113 @@
+// serial console - simple text commands over USB serial for diagnostics
+// runs on core 0 from loop(). type help for a list of commands
+
+#define CONSOLE_LINE 32
+
+struct consolecmd {
+  const char *name;
+  const char *help;
+  void (*handler)(const char *args);  // args is the rest of the line after the command name
+};
+
+void console_help(const char *args);
+
+// render [bars] sends the pattern as a MIDI file - only while stopped
+void console_render(const char *args) {
+  uint32_t bars=strtoul(args,0,10);
+  render(bars ? bars : RENDER_BARS);
+}
+
+// cycle reports the pattern period, cycle cache caches it while stopped, cycle off goes back to live playing
+void console_cycle(const char *args) {
+  if ((strcmp(args,"cache") == 0) && (controlstate != IDLE)) Serial.printf("stop the sequencer to cache\n");
+  else if (strcmp(args,"cache") == 0) {
+    char buf[20];
+    uint64_t p=cycle_build();
+    cycle_describe(buf,sizeof(buf),p);
+    Serial.printf(cycle_valid ? "cached %s\n" : "can't cache - %s\n",buf);
+  }
+  else if (strcmp(args,"off") == 0) cycle_valid=false;
+  cycle_report();
+}
+
+// preset lists the presets, preset save n and preset load n save and load them
+void console_preset(const char *args) {
+  if (strncmp(args,"save ",5) == 0) {
+    uint8_t n=atoi(args+5);
+    if (!preset_save(n-1)) Serial.printf("can't save %d\n",n);
+    else Serial.printf(preset_deferred() ? "saving %d when stopped\n" : "saving %d\n",n);
+  }
+  else if (strncmp(args,"load ",5) == 0) {
+    uint8_t n=atoi(args+5);
+    if (preset_load(n-1)) {
+      presetnumber=n;
+      if (!menumode && (UI_state < DISPLAYOFF)) UI_state=UIpages[UIpage]; // redraw with the new pattern
+      Serial.printf("loaded %d\n",n);
+    }
+    else Serial.printf("preset %d empty\n",n);
+  }
+  else preset_list();
+}
+
+// timing statistics and counters. stats reset starts the timing statistics over
+void console_stats(const char *args) {
+#ifdef TIMING_STATS
+  if (strcmp(args,"reset") == 0) {
+    for (uint8_t i=0; i<NTIMINGSTATS; ++i) timingstats[i]->resetreq=true;
+    return;
+  }
+  for (uint8_t i=0; i<NTIMINGSTATS; ++i) timingstats[i]->print();
+#else
+  (void) args;
+  Serial.printf("timing statistics compiled out - define TIMING_STATS in timing.h\n");
+#endif
+  Serial.printf("latency max us: enc %lu param %lu, param queue full %lu times dropped %lu\n",enclatency_max,paramlatency_max,paramqueue_stalls,
+    paramqueue.overflows);
+  Serial.printf("encoder scan: %d Hz scans %lu bursts %lu\n",encscan_hz,encscan_count,encscan_bursts);
+  Serial.printf("display: frames %lu deferred %lu bytes %lu frametime max %lu us\n",display.frames,display.framesdeferred,display.flushbytes,display.frametime_max);
+  Serial.printf("midi out: writes %lu max msgs %d overruns %lu stalls %lu dropped %lu event overflows %lu\n",midiout_flushes,midiout_max,
+    midiout_overruns,midiout_stalls,midiout_dropped,eventoverflows);
+}
+
+const consolecmd consolecmds[] = {
+  // name,help,handler
+  "help","list commands",console_help,
+  "render","render [bars] to a MIDI file in hex while stopped",console_render,
+  "cycle","pattern period: cycle, cycle cache (while stopped) or cycle off",console_cycle,
+  "preset","presets: preset, preset save n or preset load n",console_preset,
+  "stats","timing statistics, stats reset clears them",console_stats,
+};
+
+#define NCONSOLECMDS (sizeof(consolecmds)/sizeof(consolecmd))
+
+void console_help(const char *args) {
+  (void) args;
+  for (uint8_t i=0; i<NCONSOLECMDS; ++i) Serial.printf("%-10s %s\n",consolecmds[i].name,consolecmds[i].help);
+}
+
+// collect characters from the serial port and run a command when a line is complete
+void console_poll(void) {
+  static char line[CONSOLE_LINE];
+  static uint8_t len;
+  while (Serial.available()) {
+    char c=Serial.read();
+    if ((c != '\n') && (c != '\r')) {
+      if (len < CONSOLE_LINE-1) line[len++]=c;
+      continue;
+    }
+    if (len == 0) continue;
+    line[len]=0;
+    len=0;
+    char *args=strchr(line,' ');
+    if (args) *args++=0;
+    else args=line+strlen(line);
+    uint8_t i;
+    for (i=0; i<NCONSOLECMDS; ++i) {
+      if (strcmp(line,consolecmds[i].name) == 0) {
+        consolecmds[i].handler(args);
+        break;
+      }
+    }
+    if (i == NCONSOLECMDS) Serial.printf("unknown command %s - try help\n",line);
+  }
+}
@@ -0,0 +1,226 @@
+// pattern period analyzer and cycle cache
+// every lane has its own length and clock divider so the combined pattern can run for a long time before it repeats
+// a lane repeats every (last-first+1)*divtable[divider] ticks, ping pong every 2*(last-first) steps. random step modes
+// and probabilities between 0 and 100% never repeat. a track repeats at the LCM of its lanes, the pattern at the LCM of the tracks
+// a pattern that repeats in a reasonable time can be run through from the top once while stopped and the events it
+// schedules cached. core 1 then plays the cache by table lookup instead of working out every lane on every tick. sync
+// and start go back to the top of the cache and stop leaves it alone - only an edit that changes what the lanes play
+// or a preset load drops it
+
+#define CYCLE_RANDOM 0  // period of a lane or track that never repeats
+#define CYCLE_TOOLONG UINT64_MAX  // period too long to work out
+#define CYCLE_MAXTICKS 6144  // longest cycle that can be cached - 64 bars
+#define CYCLE_MAXENTRIES 1024  // events, flushes and state changes in a cached cycle
+#define CYCLE_START_US 1000000  // virtual time of the first tick while recording
+
+enum CYCLEENTRIES {CYCLE_STATE=EVENT_FLUSH+1}; // cache entry types are EVENTTYPES plus this
+
+struct cycleentry {
+  uint16_t tick;  // tick of the cycle it happens on
+  uint8_t type;   // EVENT_NOTEON etc, EVENT_FLUSH or CYCLE_STATE
+  uint8_t track;
+  uint8_t channel; // for CYCLE_STATE tie flag
+  uint8_t data1;   // for CYCLE_STATE active note
+  uint8_t data2;
+  int32_t offset;  // us after the tick at the recording tempo, for CYCLE_STATE the last CC
+};
+
+cycleentry cycle_cache[CYCLE_MAXENTRIES];
+uint16_t cycle_count;  // entries in the cache
+long cycle_clockperiod;  // clock period the cycle was recorded at - offsets are scaled to the current tempo
+uint32_t cycle_ticks;  // ticks played from the cache
+int16_t cyclecache;  // menu setting - cache the pattern when it is turned on
+char cycletext[20]="Cycle Cache";  // menu long name - shows the period when the cache is turned on
+
+uint64_t cycle_gcd(uint64_t a, uint64_t b) {
+  while (b) {
+    uint64_t t=a % b;
+    a=b;
+    b=t;
+  }
+  return a;
+}
+
+// combine two periods
+uint64_t cycle_lcm(uint64_t a, uint64_t b) {
+  if ((a == CYCLE_RANDOM) || (b == CYCLE_RANDOM)) return CYCLE_RANDOM;
+  if ((a == CYCLE_TOOLONG) || (b == CYCLE_TOOLONG)) return CYCLE_TOOLONG;
+  uint64_t l;
+  if (__builtin_mul_overflow(a/cycle_gcd(a,b),b,&l)) return CYCLE_TOOLONG;
+  return l;
+}
+
+// ticks before a lane repeats
+uint64_t lane_period(const sequencer &seq) {
+  int32_t steps=seq.last-seq.first+1;
+  if (steps <= 1) return divtable[seq.divider];
+  switch (seq.stepmode) {
+    case PINGPONG:
+      return (uint64_t)2*(steps-1)*divtable[seq.divider];
+    case RANDOMWALK:
+    case RANDOM:
+      return CYCLE_RANDOM;
+    default:
+      return (uint64_t)steps*divtable[seq.divider];
+  }
+}
+
+// ticks before a track repeats - only the lanes that can be heard count
+uint64_t track_period(uint8_t track) {
+  uint64_t p=1;
+  if (trackenabled[track]) {
+    sequencer *notelanes[]={&notes[track],&offsets[track],&gates[track],&velocities[track],&probability[track],&ratchets[track]};
+    for (uint8_t l=0; l<sizeof(notelanes)/sizeof(notelanes[0]); ++l) p=cycle_lcm(p,lane_period(*notelanes[l]));
+    for (int16_t s=probability[track].first; s<=probability[track].last; ++s) { // a step that may or may not play is random
+      int16_t v=probability[track].val[livebank][s];
+      if ((v > 0) && (v < PROBABILITYRANGE)) p=CYCLE_RANDOM;
+    }
+  }
+  if (mod_enabled[track]) p=cycle_lcm(p,lane_period(mods[track]));
+  return p;
+}
+
+uint64_t pattern_period(void) {
+  uint64_t p=1;
+  for (uint8_t t=0; t<NTRACKS; ++t) p=cycle_lcm(p,track_period(t));
+  return p;
+}
+
+// describe a period in bars and beats
+void cycle_describe(char *buf, uint8_t len, uint64_t p) {
+  if (p == CYCLE_RANDOM) snprintf(buf,len,"random");
+  else if (p == CYCLE_TOOLONG) snprintf(buf,len,"too long");
+  else if ((p % (PPQN*4)) == 0) snprintf(buf,len,"%llu bars",(unsigned long long)(p/(PPQN*4)));
+  else snprintf(buf,len,"%llu.%d beats",(unsigned long long)(p/PPQN),(int)((p % PPQN)*10/PPQN));
+}
+
+// core 1 - play a tick from the cache. returns false if there is no valid cache or it is warming up - the tick is played live
+bool cycle_play(long clockperiod, uint64_t ticktime) {
+  if (!cycle_valid) return false;
+  bool play=(cycle_warmup == 0);
+  while ((cycle_cursor < cycle_count) && (cycle_cache[cycle_cursor].tick == cycle_pos)) {
+    cycleentry *e=&cycle_cache[cycle_cursor++];
+    if (!play) continue; // keep the cursor in step while the lanes play live
+    switch (e->type) {
+      case EVENT_FLUSH:
+        flush_track_events(e->track,ticktime);
+        break;
+      case CYCLE_STATE:
+        active_note[e->track]=e->data1;
+        tie[e->track]=e->channel;
+        lastCC[e->track]=e->offset;
+        break;
+      default:
+        schedule_event(ticktime+(int64_t)e->offset*clockperiod/cycle_clockperiod,e->type,e->track,e->channel,e->data1,e->data2);
+        break;
+    }
+  }
+  if (++cycle_pos >= cycle_period) {
+    cycle_pos=0;
+    cycle_cursor=0;
+  }
+  if (!play) --cycle_warmup;
+  else ++cycle_ticks;
+  return play;
+}
+
+uint16_t cycle_tick;  // tick being recorded
+uint64_t cycle_ticktime;
+bool cycle_overflow;
+
+// event_record hook - add a scheduled event or flush to the cache
+void cycle_record(const seqevent *ev) {
+  if (cycle_count >= CYCLE_MAXENTRIES) {
+    cycle_overflow=true;
+    return;
+  }
+  cycle_cache[cycle_count++]={cycle_tick,ev->type,ev->track,ev->channel,ev->data1,ev->data2,(int32_t)(ev->time-cycle_ticktime)};
+}
+
+// event_capture hook while recording - nothing recorded is sent
+void cycle_discard(const seqevent *ev, uint64_t now) {}
+
+// core 0 - work out the pattern period and cache one cycle if it is short enough. only while stopped - core 1 is idled
+// while the pattern is run ahead twice and a 64 bar cycle takes a couple of hundred ms, far too long to hold up the notes
+// the pattern is synced and runs one cycle to settle ties and CC state then the second cycle is recorded. the live
+// pattern is left at the top so it starts where the cache does
+// returns the period or CYCLE_RANDOM/CYCLE_TOOLONG if it couldn't be cached
+uint64_t cycle_build(void) {
+  rp2040.idleOtherCore();
+  cycle_valid=false;
+  apply_paramchanges(); // edits already queued go live now so restoring the snapshot doesn't lose them
+  uint64_t period=pattern_period();
+  if ((period == CYCLE_RANDOM) || (period > CYCLE_MAXTICKS)) {
+    rp2040.resumeOtherCore();
+    return (period == CYCLE_RANDOM) ? CYCLE_RANDOM : CYCLE_TOOLONG;
+  }
+  sync_sequencers();
+  seq_save(&snapshot);
+  seq_offline=true;
+  event_capture=cycle_discard;
+  int16_t cyclebpm=bpm;
+  cycle_clockperiod=CLOCK_US_PER_BPM/cyclebpm;
+  cycle_count=0;
+  cycle_overflow=false;
+  int16_t note[NTRACKS],cc[NTRACKS];
+  bool tied[NTRACKS];
+  for (uint32_t n=0; n<2*period; ++n) {
+    if (n == period) { // start recording
+      event_record=cycle_record;
+      memcpy(note,active_note,sizeof(note));
+      memcpy(tied,tie,sizeof(tied));
+      memcpy(cc,lastCC,sizeof(cc));
+      for (uint8_t t=0; t<NTRACKS; ++t) cycle_cache[cycle_count++]={0,CYCLE_STATE,t,tied[t],(uint8_t)note[t],0,cc[t]}; // state at the start of the cycle
+    }
+    cycle_tick=n % period;
+    cycle_ticktime=CYCLE_START_US+(uint64_t)n*CLOCK_US_PER_BPM/cyclebpm;
+    eventcount=0; // events are recorded, not sent
+    clocktick(cycle_clockperiod,cycle_ticktime);
+    if (n < period) continue;
+    for (uint8_t t=0; t<NTRACKS; ++t) { // ties, the sounding note and the last CC carry over to live playing
+      if ((active_note[t] == note[t]) && (tie[t] == tied[t]) && (lastCC[t] == cc[t])) continue;
+      note[t]=active_note[t];
+      tied[t]=tie[t];
+      cc[t]=lastCC[t];
+      if (cycle_count < CYCLE_MAXENTRIES) cycle_cache[cycle_count++]={cycle_tick,CYCLE_STATE,t,tied[t],(uint8_t)note[t],0,cc[t]};
+      else cycle_overflow=true;
+    }
+  }
+  event_record=0;
+  event_capture=0;
+  seq_offline=false;
+  seq_restore(&snapshot);
+  cycle_period=period;
+  cycle_warmup=period;
+  cycle_ticks=0;
+  cycle_valid=!cycle_overflow;
+  rp2040.resumeOtherCore();
+  return cycle_overflow ? CYCLE_TOOLONG : period;
+}
+
+// core 0 - call from loop(). turns the menu setting off once core 1 has dropped the cache
+void cycle_poll(void) {
+  if (cycle_valid || !pending_param(&cyclecache)) return;
+  queue_param(&cyclecache,0);
+  snprintf(cycletext,sizeof(cycletext),"Cycle Cache");
+}
+
+// serial report of every lane, track and the whole pattern
+void cycle_report(void) {
+  char buf[20];
+  const char *names[]={"notes","gates","velocity","offsets","prob","ratchets","mods"};
+  for (uint8_t t=0; t<NTRACKS; ++t) {
+    Serial.printf("track %d:",t+1);
+    for (uint8_t l=0; l<NLANES; ++l) {
+      cycle_describe(buf,sizeof(buf),lane_period(lanes[l][t]));
+      Serial.printf(" %s %s",names[l],buf);
+    }
+    cycle_describe(buf,sizeof(buf),track_period(t));
+    Serial.printf("\n  repeats every %s\n",buf);
+  }
+  cycle_describe(buf,sizeof(buf),pattern_period());
+  Serial.printf("pattern repeats every %s\n",buf);
+  if (cycle_valid) Serial.printf("playing from the cache: %d ticks %d entries, %lu ticks played, %lu ticks live before it takes over\n",
+    cycle_period,cycle_count,cycle_ticks,cycle_warmup);
+  else Serial.printf("not cached\n");
+}
@@ -0,0 +1,247 @@
+// PIO scanner for the 16 multiplexed step encoders
+// a PIO state machine steps the CD4067 address lines, waits for the mux to settle and samples the encoder inputs
+// DMA moves the samples into a ring buffer that holds one scan. the DMA interrupt at the end of each scan decodes it
+// replaces bit banging the mux in the 1ms timer interrupt - the CPU only decodes, and we can scan several times per ms
+// the scan rate adapts: full rate while the encoders are being used, a low idle rate after ENCSCAN_IDLE_MS without a change
+// and lower still while the screen is blanked. the first edge seen at a low rate switches straight back to full rate
+
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+
+#define ENCSCAN_HZ 4000  // full scans of all 16 encoders per second - has to be a multiple of 1000
+#define ENCSCAN_IDLE_HZ 1000  // scan rate when nothing has changed for ENCSCAN_IDLE_MS
+#define ENCSCAN_DORMANT_HZ 250  // idle scan rate while the screen is blanked
+#define ENCSCAN_IDLE_MS 1000
+#define ENCSCAN_CYCLES (1+NENC*67)  // PIO cycles per scan - see the program below
+#define ENCSCAN_INPINS 9  // samples GPIO ENCSW_IN (14) thru ENCB_IN (22)
+
+static_assert((ENCSCAN_HZ % 1000) == 0,"encoder scan rate has to be a multiple of 1000");
+static_assert((ENCSCAN_IDLE_HZ <= 1000) && (ENCSCAN_DORMANT_HZ <= 1000),"idle scan rates tick every scan so they can't be faster than 1ms");
+static_assert(ENCSW_IN == 14 && ENCA_IN == 15 && ENCB_IN == 22,"encoder scanner sample bits assume these pins");
+static_assert(A_MUX_1 == A_MUX_0+1 && A_MUX_2 == A_MUX_0+2 && A_MUX_3 == A_MUX_0+3,"mux address pins must be consecutive");
+
+#define ENCSCAN_SW (1 << (ENCSW_IN-ENCSW_IN))  // bits of a sample word. inputs are active low
+#define ENCSCAN_A (1 << (ENCA_IN-ENCSW_IN))
+#define ENCSCAN_B (1 << (ENCB_IN-ENCSW_IN))
+
+// scans mux addresses 15 down to 0, one sample word per address
+//     set y, 15                ; 0: start of a scan
+// addr:
+//     mov pins, y      [31]    ; 1: mux address
+//     nop              [31]    ; 2: settling time
+//     in pins, 9               ; 3: sample SW, A ... B
+//     push block               ; 4
+//     jmp y-- addr             ; 5: wraps to 0 after address 0
+const uint16_t encscan_instructions[] = {
+  0xe04f, // set y, 15
+  0xbf02, // mov pins, y [31]
+  0xbf42, // nop [31]
+  0x4009, // in pins, 9
+  0x8020, // push block
+  0x0081, // jmp y--, 1
+};
+
+const pio_program encscan_program = {
+  encscan_instructions,
+  sizeof(encscan_instructions)/sizeof(uint16_t),
+  -1,
+};
+
+// encoder events - the decoder queues a record for every detent and button change so the UI only handles real input
+struct encevent {
+  uint8_t enc;  // encoder number
+  int8_t delta;  // detents turned including acceleration, 0 for a button event
+  uint8_t button;  // ClickEncoder::Closed etc or Open for a turn
+  uint32_t time;  // time_us_32() when it happened
+};
+
+SPSCQueue<encevent,64> encevents;  // decoder interrupt to loop() - both on core 0
+uint32_t enclatency,enclatency_max;  // us from the decoder to the UI handling an event
+
+// UI side - next event or false if there are none
+bool encevent_get(encevent &ev) {
+  if (!encevents.get(ev)) return false;
+  enclatency=time_us_32()-ev.time;
+  if (enclatency > enclatency_max) enclatency_max=enclatency;
+  TIMING_ADD(stat_enclat,enclatency);
+  return true;
+}
+
+// throw away events nobody is going to handle
+void encevent_flush(void) {
+  encevent ev;
+  while (encevents.get(ev));
+}
+
+// decoder for all the step encoders at once
+// the samples of a scan are packed into bitmasks, one bit per encoder, and the quadrature and button debounce
+// are worked out for all 16 encoders with a handful of bitwise operations. only encoders that moved,
+// are still accelerating or have button activity are touched individually
+struct EncoderBank {
+  uint16_t q0,q1;  // quadrature state of each encoder, same 2 bit code as ClickEncoder: bit 1 = A, bit 0 = A^B
+  uint16_t cnt0,cnt1;  // 2 bit vertical counters for button debounce
+  uint16_t down;  // debounced buttons that are down
+  uint16_t accel;  // encoders that are still accelerating
+  uint16_t busy;  // encoders whose button logic is timing something
+  uint8_t lastbutton[NENC];  // last button state queued for each encoder
+  bool events=true;  // queue encoder events - off for the host benchmark banks
+  bool primed;  // q0 and q1 have been loaded from a first sample
+
+  // one scan. a and b have a bit set for each encoder input that is active
+  void decode(ClickEncoder *e, uint16_t a, uint16_t b) {
+    uint16_t c1=a, c0=a^b;
+    if (!primed) {
+      q0=c0;
+      q1=c1;
+      primed=true;
+      return;
+    }
+    uint16_t step=q0^c0;  // bit 0 of the code changes on every quadrature step
+    if (step == 0) return;
+    uint16_t up=(q1^c1^(~q0 & c0)) & step;  // bit 1 of (last - current) mod 4 gives the direction
+    q0^=step & (q0^c0);
+    q1^=step & (q1^c1);
+    accel|=step;
+    while (step) {
+      uint8_t i=__builtin_ctz(step);
+      e[i].move((up >> i) & 1 ? 1 : -1);
+      if (events) {
+        int16_t v=e[i].takeValue();  // non zero when a detent is complete
+        if (v) encevents.put({i,(int8_t)v,ClickEncoder::Open,time_us_32()});
+      }
+      step&=step-1;
+    }
+  }
+
+  // every 1ms. sw has a bit set for each button that is down
+  void tick(ClickEncoder *e, uint16_t sw) {
+    uint16_t changed=down^sw;  // a button has to read the same for 4 ticks to change state
+    cnt0=~(cnt0 & changed);
+    cnt1=cnt0^(cnt1 & changed);
+    changed&=cnt0 & cnt1;
+    down^=changed;
+    for (uint16_t m=accel; m; m&=m-1) {
+      uint8_t i=__builtin_ctz(m);
+      if (!e[i].decay()) accel&=~(1 << i);
+    }
+    for (uint16_t m=busy|down; m; m&=m-1) {
+      uint8_t i=__builtin_ctz(m);
+      e[i].buttontick((down >> i) & 1);
+      if (e[i].buttonidle()) busy&=~(1 << i);
+      else busy|=1 << i;
+      if (events) {
+        uint8_t bt=e[i].getButton();
+        if ((bt != ClickEncoder::Open) && (bt != lastbutton[i])) encevents.put({i,0,bt,time_us_32()}); // ClickEncoder repeats states, queue changes
+        if (bt != ClickEncoder::Open) lastbutton[i]=bt;
+        if (!((down >> i) & 1)) lastbutton[i]=ClickEncoder::Open; // next press is new even if the last one is still being timed
+      }
+    }
+  }
+};
+
+// pack a scan into bitmasks - bit n is encoder n. inputs are active low
+void encscan_pack(const uint32_t *scan, uint16_t &a, uint16_t &b, uint16_t &sw) {
+  a=b=sw=0;
+  for (uint8_t i=0; i<NENC; ++i) {
+    uint32_t w=~scan[i];
+    uint16_t bit=1 << (NENC-1-i);
+    if (w & ENCSCAN_A) a|=bit;
+    if (w & ENCSCAN_B) b|=bit;
+    if (w & ENCSCAN_SW) sw|=bit;
+  }
+}
+
+PIO encscan_pio=pio0;
+uint encscan_sm;
+int encscan_dma;
+uint32_t encscan_ring[NENC] __attribute__((aligned(NENC*sizeof(uint32_t))));  // DMA ring - word i is mux address NENC-1-i
+volatile uint32_t encscan_count=0;  // scans done
+EncoderBank encbank;
+volatile uint16_t encscan_hz=ENCSCAN_HZ;  // current scan rate
+uint16_t encscan_idlehz=ENCSCAN_IDLE_HZ;  // rate to drop to when the encoders are idle
+uint8_t encscan_tickscans=ENCSCAN_HZ/1000;  // scans per encoder tick
+uint8_t encscan_tickcount;
+uint32_t encscan_lastchange;  // time_us_32() of the last change on any input
+uint32_t encscan_bursts;  // times an edge switched from a low rate to full rate
+uint16_t encscan_lasta,encscan_lastb,encscan_lastsw;
+
+// change the scan rate. the buttons and acceleration tick every 1ms or every scan if the rate is lower than that
+void encscan_setrate(uint16_t hz) {
+  if (hz == encscan_hz) return;
+  encscan_hz=hz;
+  encscan_tickscans=(hz >= 1000) ? hz/1000 : 1;
+  if (encscan_tickcount >= encscan_tickscans) encscan_tickcount=0;
+  pio_sm_set_clkdiv(encscan_pio,encscan_sm,(float)clock_get_hz(clk_sys)/((float)hz*ENCSCAN_CYCLES));
+}
+
+// set the idle scan rate - ENCSCAN_DORMANT_HZ while the screen is blanked, ENCSCAN_IDLE_HZ otherwise
+void encscan_idle(uint16_t hz) {
+  noInterrupts();
+  if (encscan_hz == encscan_idlehz) encscan_setrate(hz); // already idle - go straight to the new rate
+  encscan_idlehz=hz;
+  interrupts();
+}
+
+// end of a scan - restart the DMA for the next scan and decode this one
+void encscan_irq(void) {
+  if (!dma_channel_get_irq1_status(encscan_dma)) return;
+  TIMING_START(t);
+  dma_channel_acknowledge_irq1(encscan_dma);
+  uint32_t scan[NENC];
+  memcpy(scan,encscan_ring,sizeof(scan)); // copy before re-arming - once the DMA runs again the next scan overwrites the ring. until then new samples wait in the PIO FIFO
+  dma_channel_set_trans_count(encscan_dma,NENC,true); // write address has wrapped back to the start of the ring
+  uint16_t a,b,sw;
+  encscan_pack(scan,a,b,sw);
+  uint32_t now=time_us_32();
+  if ((a != encscan_lasta) || (b != encscan_lastb) || (sw != encscan_lastsw)) {
+    if (encscan_hz != ENCSCAN_HZ) { // something moved - scan at full rate so no edges are missed
+      encscan_setrate(ENCSCAN_HZ);
+      ++encscan_bursts;
+    }
+    encscan_lasta=a;
+    encscan_lastb=b;
+    encscan_lastsw=sw;
+    encscan_lastchange=now;
+  }
+  else if ((encscan_hz == ENCSCAN_HZ) && ((now-encscan_lastchange) > ENCSCAN_IDLE_MS*1000) && !encbank.accel && !encbank.busy) {
+    encscan_setrate(encscan_idlehz); // idle and no button timing in progress
+  }
+  encbank.decode(enc,a,b);
+  ++encscan_count;
+  if (++encscan_tickcount >= encscan_tickscans) { // acceleration and buttons run at 1ms
+    encscan_tickcount=0;
+    encbank.tick(enc,sw);
+  }
+  TIMING_END(stat_encirq,t);
+}
+
+// start the scanner - call from setup() on core 0 so the interrupt runs on core 0
+void encscan_init(void) {
+  uint offset=pio_add_program(encscan_pio,&encscan_program);
+  encscan_sm=pio_claim_unused_sm(encscan_pio,true);
+  for (uint8_t i=0; i<4; ++i) pio_gpio_init(encscan_pio,A_MUX_0+i);
+  pio_sm_set_consecutive_pindirs(encscan_pio,encscan_sm,A_MUX_0,4,true);
+  pio_sm_config c=pio_get_default_sm_config();
+  sm_config_set_out_pins(&c,A_MUX_0,4);
+  sm_config_set_in_pins(&c,ENCSW_IN);
+  sm_config_set_in_shift(&c,false,false,32); // shift left so a sample lands in the low bits
+  sm_config_set_fifo_join(&c,PIO_FIFO_JOIN_RX);
+  sm_config_set_wrap(&c,offset,offset+sizeof(encscan_instructions)/sizeof(uint16_t)-1);
+  sm_config_set_clkdiv(&c,(float)clock_get_hz(clk_sys)/((float)ENCSCAN_HZ*ENCSCAN_CYCLES));
+  pio_sm_init(encscan_pio,encscan_sm,offset,&c);
+
+  encscan_dma=dma_claim_unused_channel(true);
+  dma_channel_config d=dma_channel_get_default_config(encscan_dma);
+  channel_config_set_transfer_data_size(&d,DMA_SIZE_32);
+  channel_config_set_read_increment(&d,false);
+  channel_config_set_write_increment(&d,true);
+  channel_config_set_ring(&d,true,__builtin_ctz(sizeof(encscan_ring))); // wrap the write address every scan
+  channel_config_set_dreq(&d,pio_get_dreq(encscan_pio,encscan_sm,false));
+  dma_channel_configure(encscan_dma,&d,encscan_ring,&encscan_pio->rxf[encscan_sm],NENC,true);
+  dma_channel_set_irq1_enabled(encscan_dma,true);
+  irq_add_shared_handler(DMA_IRQ_1,encscan_irq,PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(DMA_IRQ_1,true);
+  pio_sm_set_enabled(encscan_pio,encscan_sm,true); // DMA is waiting so the first sample is address 15
+}
@@ -0,0 +1,142 @@
+// MIDI event scheduler
+// clocktick() schedules note on, note off and CC events with microsecond timestamps instead of sending them directly
+// core 1 sends each event when its deadline arrives so note lengths and ratchets don't depend on when the loop comes around
+// events are kept in a fixed size binary min heap - no allocation, runs only on core 1
+
+enum EVENTTYPES {EVENT_NOTEOFF,EVENT_CC,EVENT_NOTEON,EVENT_FLUSH}; // order matters - at the same timestamp note offs go out before note ons
+// EVENT_FLUSH never goes in the queue - it tells event_record about a flush_track_events()
+
+#define EVENT_QUEUE_SIZE (NTRACKS*16) // worst case is 4 ratchets per step per track plus note offs still pending
+
+struct seqevent {
+  uint64_t time;  // when to send the event - us since boot
+  uint8_t type;   // EVENT_NOTEON etc
+  uint8_t track;  // track that scheduled it
+  uint8_t channel; // MIDI channel 0-15
+  uint8_t data1;  // note or CC number
+  uint8_t data2;  // velocity or CC value
+};
+
+seqevent events[EVENT_QUEUE_SIZE];
+int16_t eventcount=0;  // number of events in the heap
+uint32_t eventoverflows=0; // events that didn't fit - should stay 0
+void (*event_capture)(const seqevent *ev, uint64_t sent)=0; // when set, due events go here with their send time instead of to MIDI - see render.h and host/sim.h
+void (*event_record)(const seqevent *ev)=0; // when set, sees every event scheduled and every track flush - see cycle.h
+bool seq_offline;  // set while the sequencer is run in virtual time - bench, sim, render and cycle caching. keeps it out of the live timing stats
+
+// true if event a has to be sent before event b
+bool event_before(seqevent *a, seqevent *b) {
+  if (a->time != b->time) return a->time < b->time;
+  return a->type < b->type;
+}
+
+void event_siftdown(int16_t i) {
+  for (;;) {
+    int16_t child=2*i+1;
+    if (child >= eventcount) break;
+    if ((child+1 < eventcount) && event_before(&events[child+1],&events[child])) ++child;
+    if (!event_before(&events[child],&events[i])) break;
+    seqevent temp=events[i];
+    events[i]=events[child];
+    events[child]=temp;
+    i=child;
+  }
+}
+
+void event_siftup(int16_t i) {
+  while (i > 0) {
+    int16_t parent=(i-1)/2;
+    if (!event_before(&events[i],&events[parent])) break;
+    seqevent temp=events[i];
+    events[i]=events[parent];
+    events[parent]=temp;
+    i=parent;
+  }
+}
+
+// send an event to the MIDI port
+void send_event(seqevent *ev) {
+  switch (ev->type) {
+    case EVENT_NOTEON:
+      noteOn(ev->channel,ev->data1,ev->data2);
+      break;
+    case EVENT_NOTEOFF:
+      noteOff(ev->channel,ev->data1,ev->data2);
+      break;
+    case EVENT_CC:
+      controlChange(ev->channel,ev->data1,ev->data2);
+      break;
+  }
+}
+
+// an event is going out at time now - to the capture hook if there is one, otherwise to the MIDI port
+// everything that leaves the queue goes thru here so a simulation or render on core 0 never touches the real MIDI buffer
+void event_out(seqevent *ev, uint64_t now) {
+  if (event_capture) (*event_capture)(ev,now);
+  else send_event(ev);
+}
+
+// add an event to the queue
+// if the queue is full note offs are sent right away so notes can't hang, anything else is dropped
+void schedule_event(uint64_t time, uint8_t type, uint8_t track, uint8_t channel, uint8_t data1, uint8_t data2) {
+  seqevent ev={time,type,track,channel,data1,data2};
+  if (event_record) (*event_record)(&ev);
+  if (eventcount >= EVENT_QUEUE_SIZE) {
+    ++eventoverflows;
+    if (type == EVENT_NOTEOFF) event_out(&ev,time);
+    return;
+  }
+  events[eventcount]=ev;
+  event_siftup(eventcount++);
+}
+
+// time of the next event due or UINT64_MAX if the queue is empty
+uint64_t next_event_time(void) {
+  if (eventcount == 0) return UINT64_MAX;
+  return events[0].time;
+}
+
+// send all events that are due
+void dispatch_events(uint64_t now) {
+  while ((eventcount > 0) && (events[0].time <= now)) {
+    seqevent ev=events[0];
+    events[0]=events[--eventcount];
+    event_siftdown(0);
+    if (!seq_offline) TIMING_ADD(stat_eventlate,now-ev.time);
+    event_out(&ev,now);
+  }
+}
+
+// a new step is starting on this track - pull pending note offs forward to time t and drop pending note ons
+// stops a long note or ratchet from the previous step overlapping the new one eg after a clock rate change
+void flush_track_events(uint8_t track, uint64_t t) {
+  int16_t i=0;
+  bool changed=false;
+  if (event_record) {
+    seqevent ev={t,EVENT_FLUSH,track,0,0,0};
+    (*event_record)(&ev);
+  }
+  while (i < eventcount) {
+    if (events[i].track == track) {
+      if (events[i].type == EVENT_NOTEON) {
+        events[i]=events[--eventcount];
+        changed=true;
+        continue;
+      }
+      if ((events[i].type == EVENT_NOTEOFF) && (events[i].time > t)) {
+        events[i].time=t;
+        changed=true;
+      }
+    }
+    ++i;
+  }
+  if (changed) for (i=eventcount/2-1; i>=0; --i) event_siftdown(i); // rebuild the heap
+}
+
+// stop everything - send pending note offs at time now and throw away everything else
+void flush_events(uint64_t now) {
+  for (int16_t i=0; i<eventcount; ++i) {
+    if (events[i].type == EVENT_NOTEOFF) event_out(&events[i],now);
+  }
+  eventcount=0;
+}
@@ -1,5 +1,6 @@
 
 // graphics related definitions and functions
+// primitives only draw into the framebuffer - loop() sends the changes to the display once per pass
 
 
 // canvas is the part of the screen used for graphics
@@ -17,89 +18,94 @@
 #define CANVAS_WIDTH 160 
 #endif
 
+// the step encoders edit one page of VISIBLE_STEPS steps at a time. longer sequencers have several step pages
+#define VISIBLE_STEPS (SEQ_STEPS < NENC ? SEQ_STEPS : NENC)
+#define NSTEPPAGES ((SEQ_STEPS+VISIBLE_STEPS-1)/VISIBLE_STEPS)
+#define STEP_WIDTH (CANVAS_WIDTH/VISIBLE_STEPS)
+static_assert(SEQ_STEPS % VISIBLE_STEPS == 0,"SEQ_STEPS must be a multiple of the number of step encoders");
+
+int16_t steppage=0;  // step page we are showing and editing
+
+// screen position of a step or -1 if its not on the current step page
+int16_t stepx(int16_t index) {
+  index-=steppage*VISIBLE_STEPS;
+  if ((index < 0) || (index >= VISIBLE_STEPS)) return -1;
+  return CANVAS_ORIGIN_X+STEP_WIDTH*index;
+}
+
 
 
 // plot a note on the screen
-// index = position 0-15
+// index = step 0 to SEQ_STEPS-1, steps not on the current page aren't drawn
 // note_offset = offset from root note - range +-12
 void drawnote(int16_t index,int16_t note_offset) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index;
+  int x=stepx(index);
+  if (x < 0) return;
   int y=CANVAS_ORIGIN_Y + CANVAS_HEIGHT/2 - note_offset*2; //
-  display.drawLine(x,y,x+(CANVAS_WIDTH/SEQ_STEPS), y, WHITE);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
+  display.drawLine(x,y,x+STEP_WIDTH, y, WHITE);
 }
 
 // erase a note on the screen
-// index = position 0-15
+// index = step 0 to SEQ_STEPS-1
 // note_offset = offset from root note - range +-12
 void undrawnote(int16_t index,int16_t note_offset) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index;
+  int x=stepx(index);
+  if (x < 0) return;
   int y=CANVAS_ORIGIN_Y + CANVAS_HEIGHT/2 - note_offset*2; //
-  display.drawLine(x,y,x+(CANVAS_WIDTH/SEQ_STEPS), y, BLACK);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
+  display.drawLine(x,y,x+STEP_WIDTH, y, BLACK);
 }
 
 // draw all the notes in a note sequence
-void drawnotes(sequencer p) {
-  for (int i=0;i< SEQ_STEPS;++i) drawnote(i,p.val[i]);
+void drawnotes(const sequencer &p) {
+  for (int i=steppage*VISIBLE_STEPS;i< (steppage+1)*VISIBLE_STEPS;++i) drawnote(i,p.val[editbank][i]);
 }
 
 // plot a bar on the screen
-// index = position 0-15
+// index = step 0 to SEQ_STEPS-1
 // val - unscaled height of bar
 // max - max value of val - used to scale val to the screen
 
 void drawbar(int16_t index,int16_t val, int16_t max) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index;
+  int x=stepx(index);
+  if (x < 0) return;
   int y=map(val,0,max,CANVAS_ORIGIN_Y + CANVAS_HEIGHT,CANVAS_ORIGIN_Y); //
   int height=CANVAS_ORIGIN_Y + CANVAS_HEIGHT-y;
-  display.fillRect(x,y,(CANVAS_WIDTH/SEQ_STEPS), height, WHITE);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
+  display.fillRect(x,y,STEP_WIDTH, height, WHITE);
 }
 
 void undrawbar(int16_t index,int16_t val, int16_t max) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index;
+  int x=stepx(index);
+  if (x < 0) return;
   int y=map(val,0,max,CANVAS_ORIGIN_Y + CANVAS_HEIGHT,CANVAS_ORIGIN_Y);
   int height=CANVAS_ORIGIN_Y + CANVAS_HEIGHT-y;
-  display.fillRect(x,y,(CANVAS_WIDTH/SEQ_STEPS), height, BLACK);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
+  display.fillRect(x,y,STEP_WIDTH, height, BLACK);
 }
 
 // draw all the notes in a note sequence
-void drawbars(sequencer p) {
-  for (int i=0;i< SEQ_STEPS;++i) drawbar(i,p.val[i],p.max);
+void drawbars(const sequencer &p) {
+  for (int i=steppage*VISIBLE_STEPS;i< (steppage+1)*VISIBLE_STEPS;++i) drawbar(i,p.val[editbank][i],p.max);
 }
 
 // plot index on the screen
-// index = position 0-15
+// index = step 0 to SEQ_STEPS-1
 void drawindex(int16_t index) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index+4;
+  int x=stepx(index);
+  if (x < 0) return;
+  x+=4;
   int y=CANVAS_ORIGIN_Y -4; //
   display.fillCircle(x,y,2, WHITE);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
 }
 
 void undrawindex(int16_t index) {
-  int x=CANVAS_ORIGIN_X+(CANVAS_WIDTH/SEQ_STEPS)*index+4;
+  int x=stepx(index);
+  if (x < 0) return;
+  x+=4;
   int y=CANVAS_ORIGIN_Y -4; //
   display.fillCircle(x,y,2, BLACK);
-#ifdef OLED_DISPLAY
-  display.display();
-#endif
 }
 
 // update the index on the screen - LED emulation
-void updateindex(sequencer seq) {
+void updateindex(const sequencer &seq) {
   static int16_t last_index; // tracks the sequencer index
   if (seq.index != last_index) { // draw the index marker
     undrawindex(last_index);
@@ -110,47 +116,53 @@ void updateindex(sequencer seq) {
 
 // edit a note sequence
 // both cores using the same data at the same time can cause strange things to happen
-// so we idle core 1 while core 0 is changing sequencer values
-// returns 0 or the step that was changed 1-16
+// so edits go to the edit bank and are queued for core 1 to apply to the live bank
+// returns 0 or the step that was changed 1 to SEQ_STEPS
 int16_t editnotes(sequencer *seq) {
-  int16_t encvalue,edited_step;
+  int16_t edited_step,val;
+  encevent ev;
+  pattern_sync();
   edited_step=0;  // 0 means no step changed
-  for (int steppos=0; steppos< SEQ_STEPS;++steppos) {  
-    if((encvalue=enc[steppos].getValue()) !=0) {
-      undrawnote(steppos,seq->val[steppos]);
-      rp2040.idleOtherCore();
-      seq->val[steppos]=constrain(seq->val[steppos]+encvalue,-seq->max,seq->max); // values can be + or -
-      rp2040.resumeOtherCore();
-      drawnote(steppos,seq->val[steppos]);
+  while (encevent_get(ev)) {  // encoder n edits step n of the current step page
+    if (ev.enc >= VISIBLE_STEPS) continue;
+    int16_t steppos=steppage*VISIBLE_STEPS+ev.enc;
+    if (ev.delta != 0) {
+      val=seq->val[editbank][steppos];
+      undrawnote(steppos,val);
+      val=constrain(val+ev.delta,-seq->max,seq->max); // values can be + or -
+      seq->val[editbank][steppos]=val;
+      queue_seqfield(seq,steppos,FIELD_VAL,val);
+      drawnote(steppos,val);
       edited_step=steppos+1; // if value changed return its index +1
     }
-    if (enc[steppos].getButton()==ClickEncoder::Closed) { // set end of sequence with the button
-      rp2040.idleOtherCore();
-      seq->last=steppos;
-      rp2040.resumeOtherCore();
+    else if (ev.button==ClickEncoder::Closed) { // set end of sequence with the button
+      queue_seqfield(seq,0,FIELD_LAST,steppos);
     }
   }
   return edited_step;
 }
 
 // edit a bar graph type sequence - gates, velocity etc
-// returns 0 or the step that was changed 1-16
+// returns 0 or the step that was changed 1 to SEQ_STEPS
 int16_t editbars(sequencer *seq) {
-  int16_t encvalue,edited_step;
-  edited_step=0;
-  for (int steppos=0; steppos< SEQ_STEPS;++steppos) {  
-    if((encvalue=enc[steppos].getValue()) !=0) {
-      undrawbar(steppos,seq->val[steppos],seq->max);
-      rp2040.idleOtherCore();
-      seq->val[steppos]=constrain(seq->val[steppos]+encvalue,0,seq->max); // values can be 0 to max     
-      rp2040.resumeOtherCore();
-      drawbar(steppos,seq->val[steppos],seq->max);
-      edited_step=steppos+1;
+  int16_t edited_step,val;
+  encevent ev;
+  pattern_sync();
+  edited_step=0;  // 0 means no step changed
+  while (encevent_get(ev)) {  // encoder n edits step n of the current step page
+    if (ev.enc >= VISIBLE_STEPS) continue;
+    int16_t steppos=steppage*VISIBLE_STEPS+ev.enc;
+    if (ev.delta != 0) {
+      val=seq->val[editbank][steppos];
+      undrawbar(steppos,val,seq->max);
+      val=constrain(val+ev.delta,0,seq->max); // values can be 0 to max
+      seq->val[editbank][steppos]=val;
+      queue_seqfield(seq,steppos,FIELD_VAL,val);
+      drawbar(steppos,val,seq->max);
+      edited_step=steppos+1; // if value changed return its index +1
     }
-    if (enc[steppos].getButton()==ClickEncoder::Closed) { // set end of sequence with the button
-      rp2040.idleOtherCore();
-      seq->last=steppos;
-      rp2040.resumeOtherCore();
+    else if (ev.button==ClickEncoder::Closed) { // set end of sequence with the button
+      queue_seqfield(seq,0,FIELD_LAST,steppos);
     }
   }
   return edited_step;
@@ -162,4 +174,10 @@ void drawheader(String text){
   display.setCursor(0,0);
   display.print(text+" ");
   display.print(current_track+1);
+  if (NSTEPPAGES > 1) {  // show which steps we are looking at
+    display.print(" ");
+    display.print(steppage*VISIBLE_STEPS+1);
+    display.print("-");
+    display.print((steppage+1)*VISIBLE_STEPS);
+  }
 }
\ No newline at end of file
@@ -50,6 +50,7 @@ const uint8_t submenu_Y[]= {SUBMENU_Y0,SUBMENU_Y0,SUBMENU_Y0,SUBMENU_Y0,SUBMENU_
 const uint8_t submenu_value_Y[]= {SUBMENU_VALUE_Y0,SUBMENU_VALUE_Y0,SUBMENU_VALUE_Y0,SUBMENU_VALUE_Y0,SUBMENU_VALUE_Y1,SUBMENU_VALUE_Y1,SUBMENU_VALUE_Y1,SUBMENU_VALUE_Y1};  // y location of the submenu values by pixel
 
 enum paramtype{TYPE_NONE,TYPE_INTEGER,TYPE_FLOAT, TYPE_TEXT}; // parameter display types
+enum paramscope{SCOPE_GLOBAL,SCOPE_LANE,SCOPE_TRACK}; // what a submenu template parameter belongs to - see makesubmenu()
 
 // submenus 
 struct submenu {
@@ -62,6 +63,7 @@ struct submenu {
   const char ** ptext;   // points to array of text for text display
   int16_t *parameter; // value to modify
   void (*handler)(void);  // function to call on value change
+  enum paramscope scope; // global, a field of the template lane's track 0 sequencer or element 0 of a per track array
 };
 
 // top menus
@@ -84,214 +86,136 @@ int16_t level1,pan1;
 int16_t nul;    // dummy parameter and function for testing
 void dummy( void) {}
 
+// menu function handler for the user scale degrees - rebuild the mask and its quantizer table
+void edituserscale(void) {
+  int16_t mask=0;
+  for (uint8_t d=0; d<12; ++d) if (pending_param(&userdegree[0][d])) mask|=1 << d;
+  userscale[0]=mask;
+  set_userscale(0,mask);
+  cycle_valid=false; // the quantizer table isn't in the engine so the parameter queue doesn't drop the cache
+}
+
+// menu function handler for the cycle cache - cache the pattern and show how long it is. only while stopped
+void editcycle(void) {
+  if (!pending_param(&cyclecache)) {
+    cycle_valid=false;
+    snprintf(cycletext,sizeof(cycletext),"Cycle Cache");
+    return;
+  }
+  if (controlstate != IDLE) {
+    snprintf(cycletext,sizeof(cycletext),"Stop to cache");
+    queue_param(&cyclecache,0);
+    return;
+  }
+  char buf[16];
+  uint64_t p=cycle_build();
+  cycle_describe(buf,sizeof(buf),(p == CYCLE_TOOLONG) ? pattern_period() : p);
+  snprintf(cycletext,sizeof(cycletext),"%s %s",cycle_valid ? "Cycle" : "No cache",buf);
+  if (!cycle_valid) queue_param(&cyclecache,0);
+}
+
+// menu function handlers for saving and loading presets - turning SAVE or LOAD on does it
+void savepreset(void) {
+  if (!pending_param(&presetsave)) return;
+  uint8_t n=pending_param(&presetnumber);
+  if (!preset_save(n-1)) snprintf(presettext,sizeof(presettext),"Can't save %d",n);
+  else snprintf(presettext,sizeof(presettext),preset_deferred() ? "Save %d on stop" : "Saving %d",n);
+  queue_param(&presetsave,0);
+}
+
+void loadpreset(void) {
+  if (!pending_param(&presetload)) return;
+  uint8_t n=pending_param(&presetnumber);
+  snprintf(presettext,sizeof(presettext),preset_load(n-1) ? "Loaded %d" : "Preset %d empty",n);
+  queue_param(&presetload,0);
+}
+
 // ********** menu structs that build the menu system below *********
 
 // text arrays used for submenu TYPE_TEXT fields
 const char * textoffon[] = {" OFF", "  ON"};
 const char * textstepmode[] = {" FWD", " REV","PONG","WALK","RAND"};
 //{CHROMATIC,MAJOR,MINOR,HARMONIC_MINOR,MAJOR_PENTATONIC,MINOR_PENTATONIC,DORIAN,PHRYGIAN,LYDIAN,MIXOLYDIAN};
-const char * scalenames[] = {"Chro","Maj", "Min","Hmin","MPen","mPen","Dor","Phry","Lyd","Mixo"};
+const char * scalenames[] = {"Chro","Maj", "Min","Hmin","MPen","mPen","Dor","Phry","Lyd","Mixo","User"};
+const char * textquant[] = {"  UP","DOWN","NEAR"};
 const char * textrates[] = {" 8x"," 6x"," 4x"," 3x", " 2x","1.5x"," 1x","/1.5"," /2"," /3"," /4"," /5"," /6"," /7"," /8"," /9"," /10"," /11"," /12"," /13"," /14"," /15"," /16"," /32"," /64","/128"};
 
 // NOTE that the order and number of the text menus much match the graphical UI pages
 // ie we keep the graphic display and its associated text menus in sync - uses variable UIpage for main menus - notes, gates etc
 // current_track is the index of the sequence we are editing which indexes into the submenus ie note 1, note 2
-// menus are created at compile time so we have to point to each sequencer array parameter individually
-struct submenu note1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&notes[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&notes[0].stepmode,0,
-  "ROOT","MIDI Root Note",1,115,1,TYPE_INTEGER,0,&notes[0].root,0,
-  "SCAL","Scale",0,9,1,TYPE_TEXT,scalenames,&current_scale[0],0,
-  "CHAN","MIDI Channel",1,16,1,TYPE_INTEGER,0,&MIDIchannel[0],0,
-  "ENAB","Enable Track",0,1,1,TYPE_TEXT,textoffon,&trackenabled[0],0,
-  " BPM","Beats Per Min",20,240,1,TYPE_INTEGER,0,&bpm,0,
-  "MCLK","Use MIDI clock",0,1,1,TYPE_TEXT,textoffon,&useMIDIclock,0,
-};
-
-struct submenu note2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&notes[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&notes[1].stepmode,0,
-  "ROOT","MIDI Root Note",1,115,1,TYPE_INTEGER,0,&notes[1].root,0,
-  "SCAL","Scale",0,9,1,TYPE_TEXT,scalenames,&current_scale[1],0,
-  "CHAN","MIDI Channel",1,16,1,TYPE_INTEGER,0,&MIDIchannel[1],0,
-  "ENAB","Enable Seq",0,1,1,TYPE_TEXT,textoffon,&trackenabled[1],0,
-  " BPM","Beats Per Min",20,240,1,TYPE_INTEGER,0,&bpm,0,
-  "MCLK","Use MIDI clock",0,1,1,TYPE_TEXT,textoffon,&useMIDIclock,0,
-};
-struct submenu note3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&notes[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&notes[2].stepmode,0,
-  "ROOT","MIDI Root Note",1,115,1,TYPE_INTEGER,0,&notes[2].root,0, 
-  "SCAL","Scale",0,9,1,TYPE_TEXT,scalenames,&current_scale[2],0,
-  "CHAN","MIDI Channel",1,16,1,TYPE_INTEGER,0,&MIDIchannel[2],0,
-  "ENAB","Enable Track",0,1,1,TYPE_TEXT,textoffon,&trackenabled[2],0, 
-  " BPM","Beats Per Min",20,240,1,TYPE_INTEGER,0,&bpm,0,
-  "MCLK","Use MIDI clock",0,1,1,TYPE_TEXT,textoffon,&useMIDIclock,0,
-};
-struct submenu note4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&notes[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&notes[3].stepmode,0,
-  "ROOT","MIDI Root Note",1,115,1,TYPE_INTEGER,0,&notes[3].root,0,
-  "SCAL","Scale",0,9,1,TYPE_TEXT,scalenames,&current_scale[3],0,
-  "CHAN","MIDI Channel",1,16,1,TYPE_INTEGER,0,&MIDIchannel[3],0,
-  "ENAB","Enable Track",0,1,1,TYPE_TEXT,textoffon,&trackenabled[3],0,
-  " BPM","Beats Per Min",20,240,1,TYPE_INTEGER,0,&bpm,0,
-  "MCLK","Use MIDI clock",0,1,1,TYPE_TEXT,textoffon,&useMIDIclock,0,
-};
-
-struct submenu gate1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&gates[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&gates[0].stepmode,0,
-};
-struct submenu gate2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&gates[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&gates[1].stepmode,0,
-};
-struct submenu gate3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&gates[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&gates[2].stepmode,0,
-};
-struct submenu gate4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&gates[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&gates[3].stepmode,0,
-};
-
-struct submenu velocity1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&velocities[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&velocities[0].stepmode,0,
-};
-struct submenu velocity2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&velocities[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&velocities[1].stepmode,0,
-};
-struct submenu velocity3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&velocities[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&velocities[2].stepmode,0,
-};
-struct submenu velocity4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&velocities[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&velocities[3].stepmode,0,
-};
-
-struct submenu offset1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&offsets[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&offsets[0].stepmode,0,
-};
-struct submenu offset2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&offsets[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&offsets[1].stepmode,0,
-};
-struct submenu offset3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&offsets[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&offsets[2].stepmode,0,
-};
-struct submenu offset4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&offsets[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&offsets[3].stepmode,0,
-};
-
-struct submenu probability1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&probability[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&probability[0].stepmode,0,
-  " LEN","Eucl Length",1,16,1,TYPE_INTEGER,0,&probability[0].euclen,eucprobability,
-  "BEAT","Eucl Beats",1,16,1,TYPE_INTEGER,0,&probability[0].eucbeats,eucprobability,
-  "OFFS","Eucl Offset",0,15,1,TYPE_INTEGER,0,&probability[0].root,eucprobability,
-};
-struct submenu probability2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&probability[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&probability[1].stepmode,0,
-  " LEN","Eucl Length",1,16,1,TYPE_INTEGER,0,&probability[1].euclen,eucprobability,
-  "BEAT","Eucl Beats",1,16,1,TYPE_INTEGER,0,&probability[1].eucbeats,eucprobability,
-  "OFFS","Eucl Offset",0,15,1,TYPE_INTEGER,0,&probability[1].root,eucprobability,
-};
-struct submenu probability3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&probability[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&probability[2].stepmode,0,
-  " LEN","Eucl Length",1,16,1,TYPE_INTEGER,0,&probability[2].euclen,eucprobability,
-  "BEAT","Eucl Beats",1,16,1,TYPE_INTEGER,0,&probability[2].eucbeats,eucprobability,
-  "OFFS","Eucl Offset",0,15,1,TYPE_INTEGER,0,&probability[2].root,eucprobability,
-};
-struct submenu probability4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&probability[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&probability[3].stepmode,0,
-  " LEN","Eucl Length",1,16,1,TYPE_INTEGER,0,&probability[3].euclen,eucprobability,
-  "BEAT","Eucl Beats",1,16,1,TYPE_INTEGER,0,&probability[3].eucbeats,eucprobability,
-  "OFFS","Eucl Offset",0,15,1,TYPE_INTEGER,0,&probability[3].root,eucprobability,
-};
-
-struct submenu ratchet1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&ratchets[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&ratchets[0].stepmode,0,
-};
-struct submenu ratchet2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&ratchets[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&ratchets[1].stepmode,0,
-};
-struct submenu ratchet3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&ratchets[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&ratchets[2].stepmode,0,
-};
-struct submenu ratchet4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&ratchets[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&ratchets[3].stepmode,0,
-};
-
-struct submenu mod1params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&mods[0].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&mods[0].stepmode,0,
-  "CHAN","CC MIDI Channel",1,16,1,TYPE_INTEGER,0,&CCchannel[0],0,
-  "  CC","CC Number",0,127,1,TYPE_INTEGER,0,&mods[0].root,0,
-  "ENAB","Mod On/Off",0,1,1,TYPE_TEXT,textoffon,&mod_enabled[0],0,
-};
-struct submenu mod2params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&mods[1].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&mods[1].stepmode,0,
-  "CHAN","CC MIDI Channel",1,16,1,TYPE_INTEGER,0,&CCchannel[1],0,
-  "  CC","CC Number",0,127,1,TYPE_INTEGER,0,&mods[1].root,0,
-  "ENAB","Mod On/Off",0,1,1,TYPE_TEXT,textoffon,&mod_enabled[1],0,
-};
-struct submenu mod3params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&mods[2].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&mods[2].stepmode,0,
-  "CHAN","CC MIDI Channel",1,16,1,TYPE_INTEGER,0,&CCchannel[2],0,
-  "  CC","CC Number",0,127,1,TYPE_INTEGER,0,&mods[3].root,0,
-  "ENAB","Mod On/Off",0,1,1,TYPE_TEXT,textoffon,&mod_enabled[2],0,
-};
-struct submenu mod4params[] = {
-  // name,longname,min,max,step,type,*textfield,*parameter,*handler
-  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&mods[3].divider,0,
-  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&mods[3].stepmode,0,
-  "CHAN","CC MIDI Channel",1,16,1,TYPE_INTEGER,0,&CCchannel[3],0,
-  "  CC","CC Number",0,127,1,TYPE_INTEGER,0,&mods[3].root,0,
-  "ENAB","Mod On/Off",0,1,1,TYPE_TEXT,textoffon,&mod_enabled[3],0,
-};
+// the submenus for each track are built at startup from the templates below so they follow NTRACKS
+// template parameter pointers point at track 0 - initmenus() offsets them to the track being built
+
+#define EUC_MAXLEN SEQ_STEPS // euclidean patterns can be as long as the sequencer
+
+const submenu noteparams_t0[] = {
+  // name,longname,min,max,step,type,*textfield,*parameter,*handler,scope
+  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&notes[0].divider,0,SCOPE_LANE,
+  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&notes[0].stepmode,0,SCOPE_LANE,
+  "ROOT","MIDI Root Note",1,115,1,TYPE_INTEGER,0,&notes[0].root,0,SCOPE_LANE,
+  "SCAL","Scale",0,NALLSCALES-1,1,TYPE_TEXT,scalenames,&current_scale[0],0,SCOPE_TRACK,
+  "CHAN","MIDI Channel",1,16,1,TYPE_INTEGER,0,&MIDIchannel[0],0,SCOPE_TRACK,
+  "ENAB","Enable Track",0,1,1,TYPE_TEXT,textoffon,&trackenabled[0],0,SCOPE_TRACK,
+  " BPM","Beats Per Min",20,240,1,TYPE_INTEGER,0,&bpm,0,SCOPE_GLOBAL,  // global - same for every track
+  "MCLK","Use MIDI clock",0,1,1,TYPE_TEXT,textoffon,&useMIDIclock,0,SCOPE_GLOBAL,  // global
+  "QUAN","Quantize Round",0,NQUANTMODES-1,1,TYPE_TEXT,textquant,&quantmode[0],0,SCOPE_TRACK,
+  "SEED","Random Seed",0,9999,1,TYPE_INTEGER,0,&seed[0],0,SCOPE_TRACK,
+  "LOCK","Lock Seed On Sync",0,1,1,TYPE_TEXT,textoffon,&lockseed[0],0,SCOPE_TRACK,
+  "CYCL",cycletext,0,1,1,TYPE_TEXT,textoffon,&cyclecache,editcycle,SCOPE_GLOBAL,  // global - shows the pattern period when turned on
+  "PRST",presettext,1,NPRESETS,1,TYPE_INTEGER,0,&presetnumber,0,SCOPE_GLOBAL,  // global - preset for SAVE and LOAD
+  "SAVE",presettext,0,1,1,TYPE_TEXT,textoffon,&presetsave,savepreset,SCOPE_GLOBAL,  // global
+  "LOAD",presettext,0,1,1,TYPE_TEXT,textoffon,&presetload,loadpreset,SCOPE_GLOBAL,  // global
+  "    ","",0,0,0,TYPE_NONE,0,&nul,0,SCOPE_GLOBAL,  // spacer - the user scale starts on its own page
+  "U  1","User Scale Root",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][0],edituserscale,SCOPE_GLOBAL,  // global - one toggle per degree
+  "U b2","User Scale b2",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][1],edituserscale,SCOPE_GLOBAL,
+  "U  2","User Scale 2",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][2],edituserscale,SCOPE_GLOBAL,
+  "U b3","User Scale b3",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][3],edituserscale,SCOPE_GLOBAL,
+  "U  3","User Scale 3",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][4],edituserscale,SCOPE_GLOBAL,
+  "U  4","User Scale 4",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][5],edituserscale,SCOPE_GLOBAL,
+  "U b5","User Scale b5",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][6],edituserscale,SCOPE_GLOBAL,
+  "U  5","User Scale 5",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][7],edituserscale,SCOPE_GLOBAL,
+  "U b6","User Scale b6",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][8],edituserscale,SCOPE_GLOBAL,
+  "U  6","User Scale 6",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][9],edituserscale,SCOPE_GLOBAL,
+  "U b7","User Scale b7",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][10],edituserscale,SCOPE_GLOBAL,
+  "U  7","User Scale 7",0,1,1,TYPE_TEXT,textoffon,&userdegree[0][11],edituserscale,SCOPE_GLOBAL,
+};
+
+const submenu laneparams_t0[] = {  // gates, velocities, offsets, ratchets - lane is filled in by initmenus()
+  // name,longname,min,max,step,type,*textfield,*parameter,*handler,scope
+  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&gates[0].divider,0,SCOPE_LANE,
+  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&gates[0].stepmode,0,SCOPE_LANE,
+};
+
+const submenu probabilityparams_t0[] = {
+  // name,longname,min,max,step,type,*textfield,*parameter,*handler,scope
+  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&probability[0].divider,0,SCOPE_LANE,
+  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&probability[0].stepmode,0,SCOPE_LANE,
+  " LEN","Eucl Length",1,EUC_MAXLEN,1,TYPE_INTEGER,0,&probability[0].euclen,eucprobability,SCOPE_LANE,
+  "BEAT","Eucl Beats",1,EUC_MAXLEN,1,TYPE_INTEGER,0,&probability[0].eucbeats,eucprobability,SCOPE_LANE,
+  "OFFS","Eucl Offset",0,EUC_MAXLEN-1,1,TYPE_INTEGER,0,&probability[0].root,eucprobability,SCOPE_LANE,
+};
+
+const submenu modparams_t0[] = {
+  // name,longname,min,max,step,type,*textfield,*parameter,*handler,scope
+  "RATE","Clock Rate",0,25,-1,TYPE_TEXT,textrates,&mods[0].divider,0,SCOPE_LANE,
+  "MODE","Step Mode",0,4,1,TYPE_TEXT,textstepmode,&mods[0].stepmode,0,SCOPE_LANE,
+  "CHAN","CC MIDI Channel",1,16,1,TYPE_INTEGER,0,&CCchannel[0],0,SCOPE_TRACK,
+  "  CC","CC Number",0,127,1,TYPE_INTEGER,0,&mods[0].root,0,SCOPE_LANE,
+  "ENAB","Mod On/Off",0,1,1,TYPE_TEXT,textoffon,&mod_enabled[0],0,SCOPE_TRACK,
+};
+
+#define NOTE_PARAMS (sizeof(noteparams_t0)/sizeof(submenu))
+#define LANE_PARAMS (sizeof(laneparams_t0)/sizeof(submenu))
+#define PROBABILITY_PARAMS (sizeof(probabilityparams_t0)/sizeof(submenu))
+#define MOD_PARAMS (sizeof(modparams_t0)/sizeof(submenu))
+
+submenu noteparams[NTRACKS][NOTE_PARAMS];
+submenu gateparams[NTRACKS][LANE_PARAMS];
+submenu velocityparams[NTRACKS][LANE_PARAMS];
+submenu offsetparams[NTRACKS][LANE_PARAMS];
+submenu probabilityparams[NTRACKS][PROBABILITY_PARAMS];
+submenu ratchetparams[NTRACKS][LANE_PARAMS];
+submenu modparams[NTRACKS][MOD_PARAMS];
 
 /*
 
@@ -306,38 +230,56 @@ struct submenu env0params[] = {
 };
 */
 
+// top level menu names - same order as the lanes and the UI pages
+const char * lanenames[] = {"Note","Gate","Velocity","Offset","Probability","Ratchets","Mods"};
+char menunames[NLANES*NTRACKS][16];
+
 // top level menu structure - each top level menu contains one submenu
-struct menu mainmenu[] = {
-  // name,submenu *,initial submenu index,number of submenus
-  "Note 1",note1params,0,sizeof(note1params)/sizeof(submenu),
-  "Note 2",note2params,0,sizeof(note2params)/sizeof(submenu),
-  "Note 3",note3params,0,sizeof(note3params)/sizeof(submenu),
-  "Note 4",note4params,0,sizeof(note4params)/sizeof(submenu),
-  "Gate 1",gate1params,0,sizeof(gate1params)/sizeof(submenu),
-  "Gate 2",gate2params,0,sizeof(gate2params)/sizeof(submenu),
-  "Gate 3",gate3params,0,sizeof(gate3params)/sizeof(submenu),
-  "Gate 4",gate4params,0,sizeof(gate4params)/sizeof(submenu),
-  "Velocity 1",velocity1params,0,sizeof(velocity1params)/sizeof(submenu),
-  "Velocity 2",velocity2params,0,sizeof(velocity2params)/sizeof(submenu),
-  "Velocity 3",velocity3params,0,sizeof(velocity3params)/sizeof(submenu),
-  "Velocity 4",velocity4params,0,sizeof(velocity4params)/sizeof(submenu),
-  "Offset 1",offset1params,0,sizeof(offset1params)/sizeof(submenu),
-  "Offset 2",offset2params,0,sizeof(offset2params)/sizeof(submenu),
-  "Offset 3",offset3params,0,sizeof(offset3params)/sizeof(submenu),
-  "Offset 4",offset4params,0,sizeof(offset4params)/sizeof(submenu),
-  "Probability 1",probability1params,0,sizeof(probability1params)/sizeof(submenu),
-  "Probability 2",probability2params,0,sizeof(probability2params)/sizeof(submenu),
-  "Probability 3",probability3params,0,sizeof(probability3params)/sizeof(submenu),
-  "Probability 4",probability4params,0,sizeof(probability4params)/sizeof(submenu),
-  "Ratchets 1",ratchet1params,0,sizeof(ratchet1params)/sizeof(submenu),
-  "Ratchets 2",ratchet2params,0,sizeof(ratchet2params)/sizeof(submenu),
-  "Ratchets 3",ratchet3params,0,sizeof(ratchet3params)/sizeof(submenu),
-  "Ratchets 4",ratchet4params,0,sizeof(ratchet4params)/sizeof(submenu),
-  "Mods 1",mod1params,0,sizeof(mod1params)/sizeof(submenu),
-  "Mods 2",mod2params,0,sizeof(mod2params)/sizeof(submenu),
-  "Mods 3",mod3params,0,sizeof(mod3params)/sizeof(submenu),
-  "Mods 4",mod4params,0,sizeof(mod4params)/sizeof(submenu),
-};
+// one menu per lane per track, filled in by initmenus()
+struct menu mainmenu[NLANES*NTRACKS];
+
+// copy a submenu template for track t
+// lane parameters are moved to the same field of track t's sequencer in lane, track parameters to element t of their array
+// globals like bpm are left alone
+void makesubmenu(submenu *dest, const submenu *src, uint8_t n, sequencer *srclane, sequencer *lane, uint8_t t) {
+  for (uint8_t i=0; i<n; ++i) {
+    dest[i]=src[i];
+    switch (src[i].scope) {
+      case SCOPE_LANE:  // offset of the field in the template sequencer
+        dest[i].parameter=(int16_t *)((uint8_t *)&lane[t]+((uint8_t *)src[i].parameter-(uint8_t *)&srclane[0]));
+        break;
+      case SCOPE_TRACK:
+        dest[i].parameter=src[i].parameter+t;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// build the top level menus and their submenus for all tracks
+void initmenus(void) {
+  for (uint8_t u=0; u<NUSERSCALES; ++u) userscale_unpack(u);
+  for (uint8_t t=0; t<NTRACKS; ++t) {
+    makesubmenu(noteparams[t],noteparams_t0,NOTE_PARAMS,notes,notes,t);
+    makesubmenu(gateparams[t],laneparams_t0,LANE_PARAMS,gates,gates,t);
+    makesubmenu(velocityparams[t],laneparams_t0,LANE_PARAMS,gates,velocities,t);
+    makesubmenu(offsetparams[t],laneparams_t0,LANE_PARAMS,gates,offsets,t);
+    makesubmenu(probabilityparams[t],probabilityparams_t0,PROBABILITY_PARAMS,probability,probability,t);
+    makesubmenu(ratchetparams[t],laneparams_t0,LANE_PARAMS,gates,ratchets,t);
+    makesubmenu(modparams[t],modparams_t0,MOD_PARAMS,mods,mods,t);
+    submenu *subs[NLANES]={noteparams[t],gateparams[t],velocityparams[t],offsetparams[t],probabilityparams[t],ratchetparams[t],modparams[t]};
+    int8_t counts[NLANES]={NOTE_PARAMS,LANE_PARAMS,LANE_PARAMS,LANE_PARAMS,PROBABILITY_PARAMS,LANE_PARAMS,MOD_PARAMS};
+    for (uint8_t l=0; l<NLANES; ++l) {
+      uint8_t m=l*NTRACKS+t;  // menus are grouped by lane, same as the UI pages
+      snprintf(menunames[m],sizeof(menunames[m]),"%s %d",lanenames[l],t+1);
+      mainmenu[m].name=menunames[m];
+      mainmenu[m].submenus=subs[l];
+      mainmenu[m].submenuindex=0;
+      mainmenu[m].numsubmenus=counts[l];
+    }
+  }
+}
 
 #define NUM_MAIN_MENUS sizeof(mainmenu)/ sizeof(menu)
 menu * topmenu=mainmenu;  // points at current menu
@@ -351,7 +293,6 @@ void drawtopmenu( int8_t index) {
     display.print("                    "); // kludgy line erase
     display.setCursor ( 0, TOPMENU_Y ); 
     display.print(topmenu[index].name);
-    display.display();
 }
 
 // display a sub menu item and its value
@@ -372,7 +313,7 @@ void drawsubmenu( int8_t index, int8_t pos) {
     display.print("     "); // erase old value
     display.setCursor (submenu_X[pos], submenu_value_Y[pos] ); // set cursor to parameter value field
     if ((sub[index].step !=0) && (index < topmenu[topmenuindex].numsubmenus)) { // don't print dummy parameter or beyond the last submenu item
-      int16_t val=*sub[index].parameter;  // fetch the parameter value   // 
+      int16_t val=pending_param(sub[index].parameter);  // fetch the parameter value - may not have been applied by core 1 yet
       //if (val> sub[index].max) *sub[index].parameter=val=sub[index].max; // check the parameter range and limit if its out of range ie we loaded a bad patch
      // if (val< sub[index].min) *sub[index].parameter=val=sub[index].min; // check the parameter range and limit if its out of range ie we loaded a bad patch
       char temp[5];
@@ -399,8 +340,6 @@ void drawsubmenu( int8_t index, int8_t pos) {
           break;
       } 
     }
-
-    display.display(); 
 }
 
 // display the sub menus of the current top menu
@@ -449,49 +388,39 @@ void erasemessage(void) {
     message_displayed=false; 
 }
 
+const uint8_t menuencs[SUBMENU_FIELDS]={P0,P1,P2,P3,P4,P5,P6,P7}; // encoder that changes each on screen parameter
+
 void domenus(void) {
   int16_t encoder;
   int8_t index; 
-  int16_t encodervalue[SUBMENU_FIELDS]; // each encoder changes one parameter
   ClickEncoder::Button button; 
   // process the menu encoder - scroll submenus, scroll main menu when button down
   encoder=menuenc.getValue(); // compiler bug - can't do this inside the if statement
-/*
-  if ( enc != 0) {  // if encoder is rotated, side scroll to more menu parameters if there are any
+  if (encoder != 0) {  // if encoder is rotated, side scroll to more menu parameters if there are any
       scrollsubmenus(encoder);           
   }
-*/
 
   index= topmenu[topmenuindex].submenuindex; // submenu field index
   submenu * sub=topmenu[topmenuindex].submenus; //get pointer to the current submenu array
  
   
- // process parameter encoders
-  encodervalue[0]=enc[P0].getValue();  // read encoders
-  encodervalue[1]=enc[P1].getValue();
-  encodervalue[2]=enc[P2].getValue();
-  encodervalue[3]=enc[P3].getValue();
-  encodervalue[4]=enc[P4].getValue();  // read encoders
-  encodervalue[5]=enc[P5].getValue();
-  encodervalue[6]=enc[P6].getValue();
-  encodervalue[7]=enc[P7].getValue();
-
-  for (int field=0; field<SUBMENU_FIELDS;++field) { // loop thru the on screen submenus
-    if (encodervalue[field]!=0) {  // if there is some input, process it
-      int16_t temp=*sub[index].parameter + encodervalue[field]*sub[index].step; // menu code uses ints - convert to floats when needed
-      if (temp < (int16_t)sub[index].min) temp=sub[index].min;
-      if (temp > (int16_t)sub[index].max) temp=sub[index].max;
-      rp2040.idleOtherCore();  // stop core 1 while we change the value
-      *sub[index].parameter=temp;
-      rp2040.resumeOtherCore();
-      if (sub[index].handler != 0) (*sub[index].handler)();  // call the handler function
-      erasemessage(); // undraw old longname
-      showmessage(sub[index].longname);  // show the long name of what we are editing
-      drawsubmenu(index,field);
-      //Serial.printf("index %d field %d\n",index,field);
-    }
-    ++index;
-    if (index >= topmenu[topmenuindex].numsubmenus) break; // check that we have not run out of submenus
+ // process parameter encoders - each event turns the parameter shown above its encoder
+  encevent ev;
+  while (encevent_get(ev)) {
+    if (ev.delta == 0) continue;  // buttons don't do anything in the menus
+    int8_t field;
+    for (field=0; field<SUBMENU_FIELDS;++field) if (menuencs[field] == ev.enc) break;
+    if (field == SUBMENU_FIELDS) continue; // not a parameter encoder
+    int8_t i=index+field;
+    if (i >= topmenu[topmenuindex].numsubmenus) continue; // no submenu above this encoder
+    int16_t temp=pending_param(sub[i].parameter) + ev.delta*sub[i].step; // menu code uses ints - convert to floats when needed
+    if (temp < (int16_t)sub[i].min) temp=sub[i].min;
+    if (temp > (int16_t)sub[i].max) temp=sub[i].max;
+    queue_param(sub[i].parameter,temp);  // core 1 applies the change so it doesn't have to be stopped
+    if (sub[i].handler != 0) (*sub[i].handler)();  // call the handler function
+    erasemessage(); // undraw old longname
+    showmessage(sub[i].longname);  // show the long name of what we are editing
+    drawsubmenu(i,field);
   }
 }
 
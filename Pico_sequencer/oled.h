@@ -0,0 +1,292 @@
+// SH1106 128x64 OLED driver with a local framebuffer and dirty region tracking
+// drawing only changes the framebuffer. display() sends just the parts of the pages that changed since the last call
+// so a whole UI pass costs one short SPI burst instead of a full 1K frame per primitive
+// the SH1106 is addressed in 8 pixel high pages - for each page we keep the range of columns that changed
+// frames go out by DMA: display() copies the changed segments to a second buffer, starts the transfer and returns
+// the DMA interrupt sends the page address commands and chains the segments so core 0 never waits on SPI
+// drawing carries on in the first buffer while a frame is in flight. changes made meanwhile go out with the next frame
+
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/gpio.h"
+
+#define SH1106_WIDTH 128
+#define SH1106_HEIGHT 64
+#define SH1106_PAGES (SH1106_HEIGHT/8)
+#define SH1106_COLOFFSET 2  // 128 pixel panel is centered in the controller's 132 column RAM
+#define SH1106_SPI_HZ 8000000
+#define SH1106_SWITCHCAPVCC 0x2  // for compatibility with the Adafruit driver - the panel always uses the internal charge pump
+
+#define SH1106_SPI spi0  // the hardware behind the Arduino SPI object
+
+#define BLACK 0
+#define WHITE 1
+#define INVERSE 2
+
+class OLED_SH1106;
+OLED_SH1106 *oled_dma_display;  // display the DMA interrupt works for
+
+class OLED_SH1106 : public Adafruit_GFX {
+public:
+  OLED_SH1106(int8_t dc, int8_t rst, int8_t cs) : Adafruit_GFX(SH1106_WIDTH,SH1106_HEIGHT), dcpin(dc), rstpin(rst), cspin(cs) {
+    clean();
+  }
+
+  void begin(uint8_t vccstate=SH1106_SWITCHCAPVCC) {
+    (void) vccstate;
+    pinMode(dcpin,OUTPUT);
+    pinMode(cspin,OUTPUT);
+    digitalWrite(cspin,HIGH);
+    SPI.begin();  // sets up the SPI pins, after that we use the hardware directly
+    spi_set_baudrate(SH1106_SPI,SH1106_SPI_HZ);
+    spi_set_format(SH1106_SPI,8,SPI_CPOL_0,SPI_CPHA_0,SPI_MSB_FIRST);
+    dmachannel=dma_claim_unused_channel(true);
+    dma_channel_config c=dma_channel_get_default_config(dmachannel);
+    channel_config_set_transfer_data_size(&c,DMA_SIZE_8);
+    channel_config_set_dreq(&c,spi_get_dreq(SH1106_SPI,true));
+    channel_config_set_read_increment(&c,true);
+    channel_config_set_write_increment(&c,false);
+    dma_channel_configure(dmachannel,&c,&spi_get_hw(SH1106_SPI)->dr,txbuf,0,false);
+    oled_dma_display=this;
+    dma_channel_set_irq0_enabled(dmachannel,true);
+    irq_add_shared_handler(DMA_IRQ_0,dma_irq,PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0,true);  // interrupt runs on the core that called begin()
+    if (rstpin >= 0) {
+      pinMode(rstpin,OUTPUT);
+      digitalWrite(rstpin,HIGH);
+      delay(1);
+      digitalWrite(rstpin,LOW);
+      delay(10);
+      digitalWrite(rstpin,HIGH);
+    }
+    static const uint8_t init[] = {
+      0xAE,       // display off
+      0xD5,0x80,  // clock divide
+      0xA8,0x3F,  // multiplex 64
+      0xD3,0x00,  // display offset
+      0x40,       // start line 0
+      0xAD,0x8B,  // charge pump on
+      0xA1,       // segment remap
+      0xC8,       // COM scan direction
+      0xDA,0x12,  // COM pins
+      0x81,0xCF,  // contrast
+      0xD9,0xF1,  // precharge
+      0xDB,0x40,  // VCOM detect
+      0xA4,       // display follows RAM
+      0xA6,       // normal, not inverted
+    };
+    command(init,sizeof(init));
+    fillScreen(BLACK);
+    display();
+    uint8_t on=0xAF;
+    command(&on,1);  // waits for the frame above to go out
+  }
+
+  // frame buffer is in SH1106 page order - byte x+page*128 holds pixels x,page*8 to x,page*8+7 LSB at the top
+  uint8_t *getBuffer(void) {
+    return buffer;
+  }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) {
+    fillRect(x,y,1,1,color);
+  }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    fillRect(x,y,w,1,color);
+  }
+
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    fillRect(x,y,1,h,color);
+  }
+
+  // rectangles are rotated to panel coordinates and filled a page at a time
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    switch (getRotation()) {
+      case 1:
+        fillraw(WIDTH-y-h,x,h,w,color);
+        break;
+      case 2:
+        fillraw(WIDTH-x-w,HEIGHT-y-h,w,h,color);
+        break;
+      case 3:
+        fillraw(y,HEIGHT-x-w,h,w,color);
+        break;
+      default:
+        fillraw(x,y,w,h,color);
+        break;
+    }
+  }
+
+  void fillScreen(uint16_t color) {
+    if (color == INVERSE) for (uint16_t i=0; i<sizeof(buffer); ++i) buffer[i]^=0xff;
+    else memset(buffer,(color == WHITE) ? 0xff : 0,sizeof(buffer));
+    for (uint8_t p=0; p<SH1106_PAGES; ++p) markdirty(p,0,SH1106_WIDTH-1);
+  }
+
+  void clearDisplay(void) {
+    fillScreen(BLACK);
+  }
+
+  // start sending the changed parts of the framebuffer to the display and return
+  // if the last frame is still going out nothing happens - the changes stay dirty for the next call
+  void display(void) {
+    if (inflight) {
+      ++framesdeferred;
+      return;
+    }
+    uint8_t n=0;
+    for (uint8_t p=0; p<SH1106_PAGES; ++p) {
+      if (dirtylo[p] > dirtyhi[p]) continue;
+      uint16_t offset=p*SH1106_WIDTH+dirtylo[p];
+      uint8_t len=dirtyhi[p]-dirtylo[p]+1;
+      memcpy(&txbuf[offset],&buffer[offset],len);  // the DMA reads the copy so drawing can go on
+      segments[n].page=p;
+      segments[n].col=dirtylo[p];
+      segments[n].len=len;
+      ++n;
+      flushbytes+=len;
+    }
+    clean();
+    if (n == 0) return;
+    nsegments=n;
+    cursegment=0;
+    framestart=time_us_32();
+    inflight=true;
+    gpio_put(cspin,0);
+    startsegment();
+  }
+
+  // turn the panel off - the framebuffer and the display RAM keep the image
+  void sleep(void) {
+    uint8_t off=0xAE;
+    command(&off,1);
+    sleeping=true;
+  }
+
+  // turn the panel back on showing what it had when it went to sleep plus anything flushed since
+  void wake(void) {
+    if (!sleeping) return;
+    uint8_t on=0xAF;
+    command(&on,1);
+    sleeping=false;
+  }
+
+  // true while a frame is being sent
+  bool busy(void) {
+    return inflight;
+  }
+
+  // wait for the frame in flight to finish
+  void wait(void) {
+    while (inflight) tight_loop_contents();
+  }
+
+  // DMA finished a segment - start the next or finish the frame
+  static void dma_irq(void) {
+    OLED_SH1106 *d=oled_dma_display;
+    if (!dma_channel_get_irq0_status(d->dmachannel)) return;  // shared interrupt - not ours
+    dma_channel_acknowledge_irq0(d->dmachannel);
+    if (++d->cursegment < d->nsegments) d->startsegment();
+    else {
+      while (spi_is_busy(SH1106_SPI)) tight_loop_contents();  // last bytes leave the FIFO
+      gpio_put(d->cspin,1);
+      d->frametime=time_us_32()-d->framestart;
+      if (d->frametime > d->frametime_max) d->frametime_max=d->frametime;
+      ++d->frames;
+      d->inflight=false;
+    }
+  }
+
+  // true if something has been drawn since the last display()
+  bool dirty(void) {
+    for (uint8_t p=0; p<SH1106_PAGES; ++p) if (dirtylo[p] <= dirtyhi[p]) return true;
+    return false;
+  }
+
+  uint32_t flushbytes=0; // framebuffer bytes sent - for measuring SPI traffic
+  volatile uint32_t frames=0; // frames sent
+  volatile uint32_t framesdeferred=0;  // display() calls made while a frame was in flight
+  volatile uint32_t frametime=0;  // us to send the last frame
+  volatile uint32_t frametime_max=0;
+
+protected:
+  uint8_t buffer[SH1106_WIDTH*SH1106_PAGES];  // drawing buffer
+  uint8_t txbuf[SH1106_WIDTH*SH1106_PAGES];  // copy of the changed segments being sent. same layout as buffer
+  struct segment {
+    uint8_t page,col,len;
+  } segments[SH1106_PAGES];  // changed part of each page in the frame in flight
+  volatile uint8_t nsegments,cursegment;
+  volatile bool inflight=false;
+  bool sleeping=false;
+  uint32_t framestart;
+  int dmachannel;
+  uint8_t dirtylo[SH1106_PAGES];  // first changed column of each page. > dirtyhi when the page is clean
+  uint8_t dirtyhi[SH1106_PAGES];  // last changed column
+  int8_t dcpin,rstpin,cspin;
+
+  void clean(void) {
+    memset(dirtylo,0xff,sizeof(dirtylo));
+    memset(dirtyhi,0,sizeof(dirtyhi));
+  }
+
+  void markdirty(uint8_t page, uint8_t x0, uint8_t x1) {
+    if (x0 < dirtylo[page]) dirtylo[page]=x0;
+    if (x1 > dirtyhi[page]) dirtyhi[page]=x1;
+  }
+
+  // fill a rectangle in unrotated panel coordinates
+  void fillraw(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    if (x < 0) {
+      w+=x;
+      x=0;
+    }
+    if (y < 0) {
+      h+=y;
+      y=0;
+    }
+    if (x+w > WIDTH) w=WIDTH-x;
+    if (y+h > HEIGHT) h=HEIGHT-y;
+    if ((w <= 0) || (h <= 0)) return;
+    for (int16_t p=y/8; p<=(y+h-1)/8; ++p) {
+      int16_t top=(y > p*8) ? y-p*8 : 0;  // rows of this page covered by the rectangle
+      int16_t bottom=(y+h < p*8+8) ? y+h-p*8 : 8;
+      uint8_t mask=(0xff << top) & (0xff >> (8-bottom));
+      uint8_t *b=&buffer[p*SH1106_WIDTH+x];
+      switch (color) {
+        case WHITE:
+          for (int16_t i=0; i<w; ++i) b[i]|=mask;
+          break;
+        case BLACK:
+          for (int16_t i=0; i<w; ++i) b[i]&=~mask;
+          break;
+        case INVERSE:
+          for (int16_t i=0; i<w; ++i) b[i]^=mask;
+          break;
+      }
+      markdirty(p,x,x+w-1);
+    }
+  }
+
+  // set the page and column address of the current segment then send its bytes by DMA
+  // commands are only 3 bytes so they are written directly - DC has to change between commands and data
+  void startsegment(void) {
+    segment *seg=&segments[cursegment];
+    uint8_t col=seg->col+SH1106_COLOFFSET;
+    uint8_t addr[]={(uint8_t)(0xB0 | seg->page),(uint8_t)(0x00 | (col & 0x0f)),(uint8_t)(0x10 | (col >> 4))};
+    while (spi_is_busy(SH1106_SPI)) tight_loop_contents();  // data of the last segment has to be out before DC changes
+    gpio_put(dcpin,0);
+    spi_write_blocking(SH1106_SPI,addr,sizeof(addr));
+    gpio_put(dcpin,1);
+    dma_channel_transfer_from_buffer_now(dmachannel,&txbuf[seg->page*SH1106_WIDTH+seg->col],seg->len);
+  }
+
+  // send commands - waits for any frame in flight
+  void command(const uint8_t *cmd, uint16_t len) {
+    wait();
+    gpio_put(dcpin,0);
+    gpio_put(cspin,0);
+    spi_write_blocking(SH1106_SPI,cmd,len);
+    gpio_put(cspin,1);
+  }
+};
@@ -0,0 +1,299 @@
+// preset storage in flash
+// a preset is the whole engine - every lane and track setting - plus the global settings, stored as one block
+// with a versioned header and a CRC. loading checks the header then copies the block straight out of the memory mapped flash
+// uses the flash set aside for a filesystem - pick a Flash Size with at least 64KB FS in the IDE tools menu
+// each preset has PRESET_MAXCOPIES slots it rotates thru so the sectors wear evenly. a save goes in the slot after the newest copy
+// and the header page is written last, so losing power during a save leaves the last copy intact
+// flash can't be read while it is erased or programmed so both cores are stopped meanwhile. core 1's code runs from flash
+// too (so does TinyUSB, which it calls) so it is parked with idleOtherCore() rather than kept running from RAM - a
+// deliberate tradeoff, kept out of the way of the notes instead:
+// nothing is erased while playing. the next slot of each preset is erased ahead of time, a sector (about 45 ms) per
+// loop() pass, once the sequencer has been stopped for PRESET_ERASE_DELAY_MS so a quick restart isn't held up. a save that
+// finds its slot not erased waits for that. a save programs one 256 byte page per loop() pass, and while playing only when
+// no note or clock tick is due within PRESET_GAP_US. when following MIDI clock the next tick can't be known so the pages
+// wait for the stop too
+
+#include "hardware/flash.h"
+
+#define NPRESETS 8
+#define PRESET_MAXCOPIES 4  // slots per preset
+#define PRESET_MAGIC 0x51455350  // "PSEQ"
+#define PRESET_VERSION 1  // change when the layout of struct preset changes
+#define PRESET_GAP_US 2000  // time to the next note or clock tick needed to program a page while playing
+#define PRESET_ERASE_DELAY_MS 2000  // time stopped before flash is erased
+
+extern uint8_t _FS_start[];  // filesystem area from the linker script
+extern uint8_t _FS_end[];
+
+struct presetheader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;  // sizeof(preset) it was saved with
+  uint32_t sequence;  // save counter - the valid copy with the highest is the current one
+  uint8_t number;  // preset 0 to NPRESETS-1
+  uint8_t tracks;  // NTRACKS and SEQ_STEPS it was saved with
+  uint8_t steps;
+  uint8_t livebank;  // pattern bank that was playing
+  uint32_t crc;  // CRC32 of everything after the header
+};
+
+struct preset {
+  presetheader header;
+  Engine<NTRACKS,SEQ_STEPS> engine;
+  int16_t bpm;
+  int16_t useMIDIclock;
+  int16_t userscale[NUSERSCALES];
+};
+
+#define PRESET_PAGES ((sizeof(preset)+FLASH_PAGE_SIZE-1)/FLASH_PAGE_SIZE)
+#define PRESET_SLOTSIZE (((sizeof(preset)+FLASH_SECTOR_SIZE-1)/FLASH_SECTOR_SIZE)*FLASH_SECTOR_SIZE)
+static_assert(sizeof(preset) <= UINT16_MAX,"preset too big for the header size field");
+static_assert(NPRESETS*PRESET_MAXCOPIES <= 32,"slot bitmasks are 32 bits");
+
+uint8_t preset_copies;  // slots per preset - 0 if there isn't enough flash
+uint32_t preset_sequence;  // highest sequence number in flash
+uint32_t preset_dirty;  // slots that need erasing before they can be written
+uint8_t preset_nextslot[NPRESETS];  // slot the next save of each preset goes in
+uint8_t preset_image[PRESET_PAGES*FLASH_PAGE_SIZE] __attribute__((aligned(4)));  // preset being saved
+bool preset_saving;  // a save is being programmed
+bool preset_waiting;  // the save's slot needs erasing first - waits for the sequencer to stop
+int8_t preset_eraseslot=-1;  // slot being erased
+uint8_t preset_sector;  // next sector of it to erase
+uint32_t preset_busy;  // millis() the sequencer was last seen playing
+uint8_t preset_slot;  // slot being programmed
+uint16_t preset_page;  // next page to program
+int16_t presetnumber=1;  // menu settings - preset to save or load, save and load triggers
+int16_t presetsave,presetload;
+char presettext[20]="Preset";  // menu long name - shows what happened
+
+uint32_t preset_crc(const uint8_t *data, uint32_t len) {
+  uint32_t crc=0xffffffff;
+  while (len--) {
+    crc^=*data++;
+    for (uint8_t b=0; b<8; ++b) crc=(crc >> 1) ^ (0xedb88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+uint32_t preset_offset(uint8_t slot) {  // flash offset of a slot for the SDK flash functions
+  return (uint32_t)((uintptr_t)_FS_start-XIP_BASE)+slot*PRESET_SLOTSIZE;
+}
+
+const preset *preset_at(uint8_t slot) {  // slot in the memory mapped flash
+  return (const preset *)(_FS_start+slot*PRESET_SLOTSIZE);
+}
+
+bool preset_valid(const preset *p) {
+  const presetheader *h=&p->header;
+  if ((h->magic != PRESET_MAGIC) || (h->version != PRESET_VERSION) || (h->size != sizeof(preset))) return false;
+  if ((h->tracks != NTRACKS) || (h->steps != SEQ_STEPS) || (h->number >= NPRESETS)) return false;
+  return h->crc == preset_crc((const uint8_t *)p+sizeof(presetheader),sizeof(preset)-sizeof(presetheader));
+}
+
+bool preset_erased(uint8_t slot) {
+  const uint32_t *p=(const uint32_t *)preset_at(slot);
+  for (uint32_t i=0; i<PRESET_SLOTSIZE/4; ++i) if (p[i] != 0xffffffff) return false;
+  return true;
+}
+
+// slot of the newest valid copy of preset n or -1 if there is none
+int8_t preset_newest(uint8_t n) {
+  int8_t newest=-1;
+  for (uint8_t c=0; c<preset_copies; ++c) {
+    uint8_t slot=n*preset_copies+c;
+    const preset *p=preset_at(slot);
+    if (!preset_valid(p) || (p->header.number != n)) continue;
+    if ((newest < 0) || ((int32_t)(p->header.sequence-preset_at(newest)->header.sequence) > 0)) newest=slot;
+  }
+  return newest;
+}
+
+// slot after a copy of preset n
+uint8_t preset_after(uint8_t n, uint8_t slot) {
+  return n*preset_copies+(slot-n*preset_copies+1) % preset_copies;
+}
+
+// erase the next sector of a slot - only while stopped. returns true once the whole slot is erased
+// nothing can run from flash meanwhile so interrupts are off and core 1 is parked in RAM
+bool preset_erase(uint8_t slot) {
+  if (slot != preset_eraseslot) { // a slot left part erased is started over
+    preset_eraseslot=slot;
+    preset_sector=0;
+  }
+  noInterrupts();
+  rp2040.idleOtherCore();
+  flash_range_erase(preset_offset(slot)+preset_sector*FLASH_SECTOR_SIZE,FLASH_SECTOR_SIZE);
+  rp2040.resumeOtherCore();
+  interrupts();
+  if (++preset_sector < PRESET_SLOTSIZE/FLASH_SECTOR_SIZE) return false;
+  preset_eraseslot=-1;
+  preset_dirty&=~(1UL << slot);
+  return true;
+}
+
+// program one page of the image - under a ms so it fits in a gap between notes
+void preset_program(uint8_t slot, uint16_t page) {
+  noInterrupts();
+  rp2040.idleOtherCore();
+  flash_range_program(preset_offset(slot)+page*FLASH_PAGE_SIZE,&preset_image[page*FLASH_PAGE_SIZE],FLASH_PAGE_SIZE);
+  rp2040.resumeOtherCore();
+  interrupts();
+}
+
+// find the flash area and the state of every slot - call from setup()
+void preset_init(void) {
+  uint32_t slots=(_FS_end-_FS_start)/PRESET_SLOTSIZE;
+  preset_copies=slots/NPRESETS;
+  if (preset_copies > PRESET_MAXCOPIES) preset_copies=PRESET_MAXCOPIES;
+  if (preset_copies < 2) { // need a spare slot so the last copy is never erased
+    preset_copies=0;
+    Serial.printf("presets need %d KB of flash - select a Flash Size with a bigger FS\n",NPRESETS*2*PRESET_SLOTSIZE/1024);
+    return;
+  }
+  preset_sequence=0;
+  preset_dirty=0;
+  for (uint8_t slot=0; slot<NPRESETS*preset_copies; ++slot) {
+    const preset *p=preset_at(slot);
+    if (preset_valid(p) && ((int32_t)(p->header.sequence-preset_sequence) > 0)) preset_sequence=p->header.sequence;
+    if (!preset_erased(slot)) preset_dirty|=1UL << slot;
+  }
+  for (uint8_t n=0; n<NPRESETS; ++n) {
+    int8_t newest=preset_newest(n);
+    preset_nextslot[n]=(newest < 0) ? n*preset_copies : preset_after(n,newest);
+  }
+}
+
+// start saving the current pattern and settings as preset n. the pages are written by preset_poll()
+// returns false if there is no flash for presets or a save is still going. preset_deferred() says if it waits for a stop
+bool preset_save(uint8_t n) {
+  if ((preset_copies == 0) || preset_saving || (n >= NPRESETS)) return false;
+  memset(preset_image,0xff,sizeof(preset_image));
+  preset *p=(preset *)preset_image;
+  rp2040.idleOtherCore();  // consistent copy of what core 1 is playing
+  apply_paramchanges();
+  lanes_catchup();
+  p->engine=engine;
+  p->header.livebank=livebank;
+  rp2040.resumeOtherCore();
+  p->bpm=bpm;
+  p->useMIDIclock=useMIDIclock;
+  memcpy(p->userscale,userscale,sizeof(userscale));
+  p->header.magic=PRESET_MAGIC;
+  p->header.version=PRESET_VERSION;
+  p->header.size=sizeof(preset);
+  p->header.sequence=++preset_sequence;
+  p->header.number=n;
+  p->header.tracks=NTRACKS;
+  p->header.steps=SEQ_STEPS;
+  p->header.crc=preset_crc(preset_image+sizeof(presetheader),sizeof(preset)-sizeof(presetheader));
+  preset_slot=preset_nextslot[n];
+  preset_waiting=preset_dirty & (1UL << preset_slot); // wasn't erased ahead of time - the erase takes a while
+  preset_page=(PRESET_PAGES > 1) ? 1 : 0; // header page goes last
+  preset_saving=true;
+  return true;
+}
+
+// true if a save waits for the sequencer to stop
+bool preset_deferred(void) {
+  return preset_saving && (controlstate != IDLE) && (preset_waiting || useMIDIclock);
+}
+
+// true once the sequencer has been stopped long enough to erase flash
+bool preset_idle(void) {
+  return (controlstate == IDLE) && ((millis()-preset_busy) >= PRESET_ERASE_DELAY_MS);
+}
+
+// true if core 1 can be parked for a page program without holding up a note or clock tick
+// reads core 1's schedule without a lock - a torn read costs no more than one late tick
+bool preset_quiet(void) {
+  if (controlstate == IDLE) return true;
+  if (useMIDIclock) return false; // the next MIDI clock could come at any time
+  uint64_t until=time_us_64()+PRESET_GAP_US;
+  return (next_event_time() > until) && (clock_due() > until);
+}
+
+// call from loop() - programs the next page of a save, or erases a slot ahead of time while the sequencer is stopped
+void preset_poll(void) {
+  if (preset_copies == 0) return;
+  if (controlstate != IDLE) preset_busy=millis();
+  if (preset_saving) {
+    if (preset_waiting) {
+      if (preset_idle() && preset_erase(preset_slot)) preset_waiting=false;
+      return;
+    }
+    if (!preset_quiet()) return;
+    preset_dirty|=1UL << preset_slot;
+    preset_program(preset_slot,preset_page);
+    if (preset_page == 0) { // header written - the new copy is live
+      preset_saving=false;
+      uint8_t n=((preset *)preset_image)->header.number;
+      preset_nextslot[n]=preset_after(n,preset_slot);
+      snprintf(presettext,sizeof(presettext),"Saved %d",n+1);
+    }
+    else if (++preset_page >= PRESET_PAGES) preset_page=0;
+    return;
+  }
+  if (!preset_idle()) return;
+  for (uint8_t n=0; n<NPRESETS; ++n) {
+    uint8_t slot=preset_nextslot[n];
+    if (preset_dirty & (1UL << slot)) {
+      preset_erase(slot); // a sector per pass
+      return;
+    }
+  }
+}
+
+// load preset n - returns false if there is no valid copy
+bool preset_load(uint8_t n) {
+  if ((preset_copies == 0) || (n >= NPRESETS)) return false;
+  int8_t slot=preset_newest(n);
+  if (slot < 0) return false;
+  const preset *p=preset_at(slot);
+  rp2040.idleOtherCore();
+  apply_paramchanges(); // so nothing queued before the load lands on top of it
+  engine=p->engine; // one block copy out of flash
+  if (p->header.livebank != livebank) { // the bank that was playing when it was saved plays now
+    for (uint8_t l=0; l<NLANES; ++l) {
+      for (uint8_t t=0; t<NTRACKS; ++t) memcpy(lanes[l][t].val[livebank],lanes[l][t].val[livebank^1],sizeof(lanes[l][t].val[0]));
+    }
+  }
+  swaprequest=false;
+  editbank=livebank; // pattern_sync() refreshes the edit bank from the live one
+  cycle_valid=false;
+  cycle_behind=0; // the lanes are where they were saved
+  bpm=p->bpm;
+  useMIDIclock=p->useMIDIclock;
+  rp2040.resumeOtherCore();
+  for (uint8_t u=0; u<NUSERSCALES; ++u) {
+    userscale[u]=p->userscale[u];
+    set_userscale(u,userscale[u]);
+    userscale_unpack(u);
+  }
+  return true;
+}
+
+// load the preset saved last - call at the end of setup()
+void preset_loadlast(void) {
+  for (uint8_t slot=0; slot<NPRESETS*preset_copies; ++slot) {
+    const preset *p=preset_at(slot);
+    if (preset_valid(p) && (p->header.sequence == preset_sequence)) {
+      preset_load(p->header.number);
+      presetnumber=p->header.number+1;
+      return;
+    }
+  }
+}
+
+void preset_list(void) {
+  if (preset_copies == 0) {
+    Serial.printf("no flash for presets\n");
+    return;
+  }
+  Serial.printf("%d presets, %d slots of %d bytes each\n",NPRESETS,preset_copies,PRESET_SLOTSIZE);
+  for (uint8_t n=0; n<NPRESETS; ++n) {
+    int8_t slot=preset_newest(n);
+    if (slot < 0) Serial.printf("%d empty\n",n+1);
+    else Serial.printf("%d saved %lu slot %d\n",n+1,preset_at(slot)->header.sequence,slot);
+  }
+  if (preset_saving) Serial.printf("saving to slot %d page %d\n",preset_slot,preset_page);
+}
@@ -0,0 +1,228 @@
+// offline render - runs the sequencer as fast as it will go from the start of the pattern and writes the result
+// as a type 1 Standard MIDI File with one MTrk per track, for auditioning and archiving long generative patterns
+// seqhost render [bars] [file] renders on the host straight to a file - an hour takes a fraction of a second
+// on the Pico type render [bars] in the serial console while the sequencer is stopped. the file comes out as hex between
+// "SMF begin" and "SMF end" lines so it can be pulled out of a terminal log,
+// eg with sed -n '/SMF begin/,/SMF end/p' | grep -v SMF | xxd -r -p > out.mid
+// ticks are computed in virtual time so rendering doesn't wait for the clock. random lanes are reseeded like a sync,
+// so with lock seed on a track renders the same every time
+// the sequencer is run once to size the track chunks then once per track to write them. the render runs on the same
+// sequencer globals core 1 plays from, so it only runs while stopped and core 1 is idled while it computes. it works a bar
+// at a time into a RAM buffer - between slices the live state is put back, core 1 is resumed and the buffer is sent, so
+// MIDI start, clock and queued edits aren't held up while the hex trickles out. a start in the middle ends the render
+
+#define RENDER_BARS 16  // default length
+#define RENDER_MAXBARS 2000  // an hour at 133 BPM
+#define RENDER_DIVISION (PPQN*40)  // SMF ticks per quarter note - fine enough for ratchets and gate lengths
+#define RENDER_START_US 1000000  // virtual time of the first tick
+#define RENDER_SLICE (PPQN*4)  // most ticks worked out with core 1 idled - a bar
+#define RENDER_BUFSIZE 2048  // bytes buffered while core 1 is idled. sent when half full or at the end of a slice
+static_assert(EVENT_QUEUE_SIZE*8+NTRACKS*8 < RENDER_BUFSIZE/2,"one tick's events have to fit in the rest of the render buffer");
+
+seqsnapshot render_startstate;  // pattern as it is at the start of the render
+seqsnapshot render_state;  // where the render got to while core 1 runs the live pattern
+uint8_t render_buf[RENDER_BUFSIZE];
+uint16_t render_fill;  // bytes in render_buf
+uint32_t render_len[NTRACKS+1];  // bytes in each MTrk chunk, chunk 0 is tempo etc
+uint64_t render_last[NTRACKS+1];  // SMF time of the last event written to each chunk
+int8_t render_chunk;  // chunk being written or -1 while sizing the chunks
+uint8_t render_col;  // hex output column
+int16_t render_bpm;
+void (*render_out)(uint8_t b);  // where the file goes - hex over serial or a file on the host
+
+void render_hex(uint8_t b) {
+  Serial.printf("%02x",b);
+  if (++render_col == 32) {
+    Serial.printf("\n");
+    render_col=0;
+  }
+}
+
+void render_event(const seqevent *ev, uint64_t sent);
+
+// buffer a byte of the file
+void render_put(uint8_t b) {
+  if (render_fill < RENDER_BUFSIZE) render_buf[render_fill++]=b;
+}
+
+// send what is buffered - core 1 isn't idled
+void render_flush(void) {
+  for (uint16_t i=0; i<render_fill; ++i) (*render_out)(render_buf[i]);
+  render_fill=0;
+}
+
+// add a byte to a chunk - counted while sizing, buffered if it is the chunk being written
+void render_byte(uint8_t chunk, uint8_t b) {
+  if (render_chunk < 0) ++render_len[chunk];
+  else if (render_chunk == chunk) render_put(b);
+}
+
+// core 0 - let core 1 run and send the buffer. the render's copy of the sequencer is swapped out for the live one meanwhile
+// returns false if the sequencer was started - core 1 is left running the live pattern
+bool render_yield(void) {
+  seq_save(&render_state);
+  event_capture=0;
+  seq_offline=false;
+  seq_restore(&snapshot);
+  rp2040.resumeOtherCore();
+  render_flush();
+  if (controlstate != IDLE) {
+    return false;
+  }
+  rp2040.idleOtherCore();
+  apply_paramchanges();
+  seq_save(&snapshot);
+  seq_restore(&render_state);
+  event_capture=render_event;
+  seq_offline=true;
+  return true;
+}
+
+// SMF variable length quantity
+void render_varlen(uint8_t chunk, uint32_t v) {
+  uint8_t buf[5];
+  uint8_t n=0;
+  do {
+    buf[n++]=v & 0x7f;
+    v>>=7;
+  } while (v);
+  while (n > 1) render_byte(chunk,buf[--n] | 0x80);
+  render_byte(chunk,buf[0]);
+}
+
+// us since the start of the render to SMF ticks, rounded
+uint64_t render_smftime(uint64_t t) {
+  return ((t-RENDER_START_US)*RENDER_DIVISION*render_bpm+30000000)/60000000;
+}
+
+void render_midi(uint8_t chunk, uint64_t smftime, uint8_t status, uint8_t data1, uint8_t data2) {
+  if (smftime < render_last[chunk]) smftime=render_last[chunk]; // a tied note ended before a pending note off
+  render_varlen(chunk,smftime-render_last[chunk]);
+  render_last[chunk]=smftime;
+  render_byte(chunk,status);
+  render_byte(chunk,data1);
+  render_byte(chunk,data2);
+}
+
+// event capture hook - write the event at the time it was scheduled for
+void render_event(const seqevent *ev, uint64_t sent) {
+  (void) sent;
+  uint8_t status;
+  switch (ev->type) {
+    case EVENT_NOTEON:
+      status=0x90;
+      break;
+    case EVENT_NOTEOFF:
+      status=0x80;
+      break;
+    default:
+      status=0xb0;
+      break;
+  }
+  render_midi(ev->track+1,render_smftime(ev->time),status | (ev->channel & 0x0f),ev->data1 & 0x7f,ev->data2 & 0x7f);
+}
+
+void render_endtrack(uint8_t chunk) {
+  render_varlen(chunk,0);
+  render_byte(chunk,0xff);
+  render_byte(chunk,0x2f);
+  render_byte(chunk,0);
+}
+
+// run the sequencer for ticks clock ticks from the start state, writing or sizing chunks as set by render_chunk
+// returns false if the render was stopped
+bool render_pass(uint32_t ticks) {
+  seq_restore(&render_startstate);
+  eventcount=0;
+  memset(render_last,0,sizeof(render_last));
+
+  // chunk 0 - tempo and time signature
+  uint32_t tempo=60000000L/render_bpm;
+  const uint8_t conductor[]={0x00,0xff,0x51,0x03,(uint8_t)(tempo >> 16),(uint8_t)(tempo >> 8),(uint8_t)tempo,
+                             0x00,0xff,0x58,0x04,0x04,0x02,0x18,0x08};
+  for (uint8_t i=0; i<sizeof(conductor); ++i) render_byte(0,conductor[i]);
+  render_endtrack(0);
+
+  for (uint8_t t=0; t<NTRACKS; ++t) { // track names
+    char name[10];
+    uint8_t len=snprintf(name,sizeof(name),"Track %d",t+1);
+    render_varlen(t+1,0);
+    render_byte(t+1,0xff);
+    render_byte(t+1,0x03);
+    render_byte(t+1,len);
+    for (uint8_t i=0; i<len; ++i) render_byte(t+1,name[i]);
+  }
+
+  if (render_chunk == 0) return true; // only the conductor chunk is being written - no need to run the sequencer
+
+  long clockperiod=CLOCK_US_PER_BPM/render_bpm;
+  for (uint32_t n=0; n<ticks; ++n) {
+    uint64_t ticktime=RENDER_START_US+(uint64_t)n*CLOCK_US_PER_BPM/render_bpm; // same grid as do_clocks()
+    dispatch_events(ticktime-1); // everything before this tick. events at ticktime go out in order after it is scheduled
+    clocktick(clockperiod,ticktime);
+    if ((((n+1) % RENDER_SLICE) == 0) || (render_fill >= RENDER_BUFSIZE/2)) {
+      if (!render_yield()) return false;
+    }
+  }
+  uint64_t end=RENDER_START_US+(uint64_t)ticks*CLOCK_US_PER_BPM/render_bpm;
+  dispatch_events(UINT64_MAX); // note offs still pending
+  for (uint8_t t=0; t<NTRACKS; ++t) {
+    if (tie[t]) render_midi(t+1,render_smftime(end),0x80 | ((MIDIchannel[t]-1) & 0x0f),active_note[t],0); // end tied notes
+    render_endtrack(t+1);
+  }
+  return true;
+}
+
+// render bars bars to render_out. returns the size of the file, 0 if the sequencer was started part way thru
+uint32_t render_smf(uint32_t bars) {
+  if (bars > RENDER_MAXBARS) bars=RENDER_MAXBARS;
+  uint32_t ticks=bars*PPQN*4;
+  render_fill=0;
+  rp2040.idleOtherCore();
+  apply_paramchanges(); // edits already queued go live now so restoring the snapshot doesn't lose them
+  seq_save(&snapshot);
+  sync_sequencers(); // start from the top of the pattern
+  seq_save(&render_startstate);
+  render_bpm=bpm;
+  event_capture=render_event;
+  seq_offline=true;
+
+  render_chunk=-1;
+  memset(render_len,0,sizeof(render_len));
+  if (!render_pass(ticks)) return 0;
+
+  const uint8_t header[]={'M','T','h','d',0,0,0,6,0,1,0,NTRACKS+1,(uint8_t)(RENDER_DIVISION >> 8),(uint8_t)RENDER_DIVISION};
+  uint32_t size=sizeof(header);
+  for (uint8_t i=0; i<sizeof(header); ++i) render_put(header[i]);
+  for (render_chunk=0; render_chunk<=NTRACKS; ++render_chunk) {
+    const uint8_t chunk[]={'M','T','r','k',(uint8_t)(render_len[render_chunk] >> 24),(uint8_t)(render_len[render_chunk] >> 16),
+                           (uint8_t)(render_len[render_chunk] >> 8),(uint8_t)render_len[render_chunk]};
+    for (uint8_t i=0; i<sizeof(chunk); ++i) render_put(chunk[i]);
+    if (!render_pass(ticks)) return 0;
+    size+=sizeof(chunk)+render_len[render_chunk];
+  }
+
+  event_capture=0;
+  seq_offline=false;
+  seq_restore(&snapshot);
+  rp2040.resumeOtherCore();
+  render_flush();
+  return size;
+}
+
+// render over serial in hex - only while stopped
+void render(uint32_t bars) {
+  if (controlstate != IDLE) {
+    Serial.printf("stop the sequencer to render\n");
+    return;
+  }
+  uint32_t start=millis();
+  Serial.printf("SMF begin %d tracks %lu bars %d BPM\n",NTRACKS,(bars > RENDER_MAXBARS) ? RENDER_MAXBARS : bars,bpm);
+  render_col=0;
+  render_out=render_hex;
+  uint32_t size=render_smf(bars);
+  if (render_col) Serial.printf("\n");
+  Serial.printf("SMF end\n");
+  if (size == 0) Serial.printf("render stopped - the sequencer was started\n");
+  Serial.printf("rendered in %lu ms\n",millis()-start);
+}
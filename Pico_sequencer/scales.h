@@ -12,26 +12,70 @@
 #define LYDIAN 0xad5
 #define MIXOLYDIAN 0x6b5
 
-uint16_t scales[] ={CHROMATIC,MAJOR,MINOR,HARMONIC_MINOR,MAJOR_PENTATONIC,MINOR_PENTATONIC,DORIAN,PHRYGIAN,LYDIAN,MIXOLYDIAN};
-int16_t current_scale[NTRACKS]={1,1,1,1}; // index of scale in use for each track
+#define WHOLE_TONE 0x555
 
-uint16_t rotate12left(uint16_t n, uint16_t d) {
-  return 0xfff & ((n << (d % 12)) | (n >> (12 - (d % 12))));
-}
+#define NSCALES 10  // built in scales
+#define NUSERSCALES 1  // user scales follow the built in ones
+#define NALLSCALES (NSCALES+NUSERSCALES)
+
+constexpr uint16_t scales[NALLSCALES] ={CHROMATIC,MAJOR,MINOR,HARMONIC_MINOR,MAJOR_PENTATONIC,MINOR_PENTATONIC,DORIAN,PHRYGIAN,LYDIAN,MIXOLYDIAN,WHOLE_TONE};
+
+// quantizer rounding - notes not in the scale move up, down or to the nearest scale note (up on a tie)
+enum QUANTMODES {QUANT_UP,QUANT_DOWN,QUANT_NEAREST,NQUANTMODES};
 
-uint16_t rotate12right(uint16_t n, uint16_t d) {
-  return 0xfff & ((n >> (d % 12)) | (n << (12 - (d % 12))));
+// semitones to add to pitch class pc to put it in scale with the given root pitch class
+// searches the whole octave so sparse scales work. an empty scale leaves notes alone
+constexpr int8_t quantdelta(uint16_t scale, uint8_t root, uint8_t pc, uint8_t mode) {
+  if ((scale & 0xfff) == 0) return 0;
+  uint8_t interval=(pc+12-root)%12; // scale bit 0 is the root
+  int8_t up=0, down=0;
+  while (!((scale >> ((interval+up)%12)) & 1)) ++up;
+  while (!((scale >> ((interval+12-down)%12)) & 1)) ++down;
+  if (mode == QUANT_UP) return up;
+  if (mode == QUANT_DOWN) return -down;
+  return (up <= down) ? up : -down;
 }
 
-// quantize MIDI notes 0-128 to scale with given MIDI root note 0-128
-uint8_t quantize(uint8_t note, uint16_t scale,uint8_t root){
-  uint8_t n = note%12; // reduce to one octave
-  uint8_t key = root%12;
-  scale=rotate12left(scale,key); // adjust scale mask into the right key
-  for (int i=0;i<3;++i) {  // quantize up, max 2 notes
-    if (bitRead(scale,n)) return note;
-    scale=rotate12right(scale,1);
-    ++note;
+// quantizer lookup table indexed by [mode][scale][root pitch class][note pitch class]
+// generated at compile time but kept in RAM so clocktick() doesn't take flash cache misses, and user scales can be changed
+struct QuantTable {
+  int8_t delta[NQUANTMODES][NALLSCALES][12][12];
+
+  constexpr QuantTable() : delta{} {
+    for (uint8_t m=0; m<NQUANTMODES; ++m)
+      for (uint8_t s=0; s<NALLSCALES; ++s)
+        for (uint8_t r=0; r<12; ++r)
+          for (uint8_t n=0; n<12; ++n) delta[m][s][r][n]=quantdelta(scales[s],r,n,m);
   }
-  return note; // failed to quantize - should not happen for most scales
+};
+
+QuantTable quanttable;
+
+static_assert(QuantTable().delta[QUANT_UP][1][0][1] == 1,"C# quantizes up to D in C major");
+static_assert(QuantTable().delta[QUANT_DOWN][4][2][3] == -1,"D# quantizes down to D in D major pentatonic");
+static_assert(QuantTable().delta[QUANT_NEAREST][4][0][5] == -1,"F quantizes to E in C major pentatonic");
+
+int16_t userscale[NUSERSCALES]={WHOLE_TONE}; // 12 bit masks, 1st note at LSB
+int16_t userdegree[NUSERSCALES][12];  // the same scales as one on/off per semitone above the root - what the menus edit
+
+// set the menu toggles of a user scale from its mask
+void userscale_unpack(uint8_t u) {
+  for (uint8_t d=0; d<12; ++d) userdegree[u][d]=(userscale[u] >> d) & 1;
+}
+
+// rebuild the table rows of a user scale - runs on core 0
+// core 1 may read the rows while they change but every entry is valid for either the old or the new scale
+void set_userscale(uint8_t u, uint16_t scale) {
+  for (uint8_t m=0; m<NQUANTMODES; ++m)
+    for (uint8_t r=0; r<12; ++r)
+      for (uint8_t n=0; n<12; ++n) quanttable.delta[m][NSCALES+u][r][n]=quantdelta(scale,r,n,m);
+}
+
+// quantize MIDI notes 0-127 to scale with given MIDI root note 0-127
+// scale is an index into scales[]. one table load instead of searching the scale mask
+uint8_t quantize(uint8_t note, uint8_t scale, uint8_t root, uint8_t mode) {
+  int16_t q=note+quanttable.delta[mode][scale][root%12][note%12];
+  if (q > 127) q-=12;  // stay in MIDI range and in the scale
+  if (q < 0) q+=12;
+  return q;
 }
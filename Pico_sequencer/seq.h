@@ -1,6 +1,6 @@
 // sequencer related definitions and structures
 
-#define SEQ_STEPS 16 // 16 step sequencer
+#define SEQ_STEPS 16 // steps per sequencer - 16 or a multiple of 16 (one page of step encoders) ie 32, 64
 #define NOTERANGE 12 // notes can be +- one octave from root - display limitation
 #define GATERANGE 7  // gate time 0-7 ie 12.5% increments
 #define VELOCITYRANGE 32  // velocity has 32 steps ie 2.5% per step. makes spinning the encoder less tedious
@@ -12,13 +12,8 @@
 // clock related stuff
 enum STEPMODE {FORWARD,BACKWARD,PINGPONG,RANDOMWALK,RANDOM};
 
-long clocktimer = 0; // clock rate in ms
-long notetimer[NTRACKS]={0,0,0,0}; // note off timer
-int16_t active_note[NTRACKS]; // note # note in progress, 0 if no note sounding
-int16_t active_velocity[NTRACKS]; // velocity of the active note
-int16_t active_notelength[NTRACKS]; //length of the active note in ms
+int16_t active_note[NTRACKS]; // note # of the last note started on the track
 bool tie[NTRACKS];  // flag that a tied note is in progress
-int16_t ratchetcnt[NTRACKS]; // number of ratchets for the note 
 // const char * textrates[] = {" 8x"," 6x"," 4x"," 3x", " 2x","1.5x"," 1x","/1.5"," /2"," /3"," /4"," /5"," /6"," /7"," /8"," /9"," /10"," /11"," /12"," /13"," /14"," /15"," /16"," /32"," /64"," /128"};
 int16_t divtable[] = {3,4,6,8,12,16,24,36,48,72,96,120,144,168,192,216,240,264,288,312,336,360,384,768,1536,3072};
 
@@ -30,8 +25,8 @@ int16_t lastCC[NTRACKS]; // we save the last CC message - reduce MIDI traffic by
 // note that there are two threads of execution running on the two Pico cores - UI and note handling
 // must be careful about editing items that are used by the 2nd Pico core for note timing etc
 
-struct sequencer {
-  int16_t val[SEQ_STEPS];  // values of note offsets from root, gate lengths etc. 
+template <int STEPS> struct Sequencer {
+  int16_t val[2][STEPS];  // values of note offsets from root, gate lengths etc. double buffered - see pattern banks below
   int16_t max;    // maximum positive value of val - used for UI scaling
   int16_t index;    // index of step we are on
   int16_t stepmode;    // step mode - fwd, backward etc
@@ -43,392 +38,333 @@ struct sequencer {
   int16_t divider;   // clock rate divider - lookup via table
   int16_t clockticks;   //  clock counter
   int16_t root;   // "root" note - note offsets are relative to this. also used for euclidean offset and CC number
+  uint32_t rng;   // random number generator state for probability and the random step modes
 };
 
-// notes are stored as offsets from the root 
-sequencer notes[NTRACKS] = {
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-};
+typedef Sequencer<SEQ_STEPS> sequencer;
+
+// each lane has its own xorshift32 random number generator so random sequences are reproducible from a seed
+// and lanes don't disturb each other. a lane's generator is seeded from the track seed, track and lane
+constexpr uint32_t seedhash(uint16_t seed, uint8_t track, uint8_t lane) {
+  uint32_t h=seed*0x9e3779b9u ^ (track << 8 | lane)*0x85ebca6bu;  // mix the bits like a murmur3 finalizer
+  h^=h >> 16;
+  h*=0x7feb352du;
+  h^=h >> 15;
+  h*=0x846ca68bu;
+  h^=h >> 16;
+  return h ? h : 1;  // xorshift gets stuck at 0
+}
 
-// offsets (translations) are added to the current note
-sequencer offsets[NTRACKS] = {
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  // initial data
-  NOTERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-};
+// power up settings for a sequencer - all steps set to initval, full length, 1x clock rate
+template <int STEPS> constexpr Sequencer<STEPS> makelane(int16_t initval, int16_t max, int16_t root, uint32_t rng) {
+  Sequencer<STEPS> seq{};
+  for (int i=0; i<STEPS; ++i) {
+    seq.val[0][i]=initval;
+    seq.val[1][i]=initval;
+  }
+  seq.max=max;
+  seq.index=0;
+  seq.stepmode=FORWARD;
+  seq.state=0;
+  seq.first=0;
+  seq.last=STEPS-1;
+  seq.euclen=STEPS;
+  seq.eucbeats=1;
+  seq.divider=6;  // 1x clock
+  seq.clockticks=24;
+  seq.root=root;
+  seq.rng=rng;
+  return seq;
+}
 
-sequencer gates[NTRACKS] = {
-  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,  // initial data
-  GATERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,  // initial data
-  GATERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,  // initial data
-  GATERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,  // initial data
-  GATERANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
+// all the sequencer and track data for a TRACKS track, STEPS step sequencer
+// the constructor is constexpr so the power up settings are built at compile time and the engine sits in initialized data
+// change NTRACKS or SEQ_STEPS to resize everything - memory use scales exactly with the configuration
+template <int TRACKS, int STEPS> struct Engine {
+  Sequencer<STEPS> notes[TRACKS];  // notes are stored as offsets from the root 
+  Sequencer<STEPS> offsets[TRACKS];  // offsets (translations) are added to the current note
+  Sequencer<STEPS> gates[TRACKS];
+  Sequencer<STEPS> ratchets[TRACKS];
+  Sequencer<STEPS> velocities[TRACKS];  // velocities have MIDI values 0-127 
+  Sequencer<STEPS> probability[TRACKS];
+  Sequencer<STEPS> mods[TRACKS];  // modulation values
+  int16_t MIDIchannel[TRACKS]; // midi channel to use for sequencer notes
+  int16_t trackenabled[TRACKS]; // 1 if track on is 1, 0 if off
+  int16_t CCchannel[TRACKS]; // midi channel to use for CCs
+  int16_t mod_enabled[TRACKS]; // 1 if mod sequencer for track is on, 0 if off
+  int16_t current_scale[TRACKS]; // index of scale in use for each track
+  int16_t quantmode[TRACKS]; // quantizer rounding QUANT_UP etc
+  int16_t seed[TRACKS]; // random seed for the track's lanes
+  int16_t lockseed[TRACKS]; // 1 if the lanes are reseeded from seed on every sync so random parts repeat exactly
+
+  constexpr Engine() : notes{},offsets{},gates{},ratchets{},velocities{},probability{},mods{},
+                       MIDIchannel{},trackenabled{},CCchannel{},mod_enabled{},current_scale{},quantmode{},seed{},lockseed{} {
+    for (int t=0; t<TRACKS; ++t) {
+      seed[t]=t+1;
+      lockseed[t]=0;
+      // lane numbers for the seeds are the same as enum LANES below
+      notes[t]=makelane<STEPS>(0,NOTERANGE,60,seedhash(seed[t],t,0));
+      gates[t]=makelane<STEPS>(3,GATERANGE,60,seedhash(seed[t],t,1));
+      velocities[t]=makelane<STEPS>(22,VELOCITYRANGE,60,seedhash(seed[t],t,2));  // ~ 80% velocity
+      offsets[t]=makelane<STEPS>(0,NOTERANGE,60,seedhash(seed[t],t,3));
+      probability[t]=makelane<STEPS>(PROBABILITYRANGE,PROBABILITYRANGE,0,seedhash(seed[t],t,4));  // 100% probability. root holds euclidean offset in this case
+      ratchets[t]=makelane<STEPS>(0,RATCHETRANGE,60,seedhash(seed[t],t,5));
+      mods[t]=makelane<STEPS>(-1,MODRANGE,16+t,seedhash(seed[t],t,6));  // -1 means no CC sent. root holds CC number in this case
+      MIDIchannel[t]=t%16+1;
+      trackenabled[t]=(t==0);  // only the first track plays on power up
+      CCchannel[t]=t%16+1;
+      mod_enabled[t]=0;
+      current_scale[t]=1;  // major
+      quantmode[t]=QUANT_UP;
+    }
+  }
 };
 
-sequencer ratchets[NTRACKS] = {
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // initial data
-  RATCHETRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // initial data
-  RATCHETRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // initial data
-  RATCHETRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // initial data
-  RATCHETRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
+Engine<NTRACKS,SEQ_STEPS> engine;
+
+// the rest of the code uses the engine arrays by name
+sequencer (&notes)[NTRACKS]=engine.notes;
+sequencer (&offsets)[NTRACKS]=engine.offsets;
+sequencer (&gates)[NTRACKS]=engine.gates;
+sequencer (&ratchets)[NTRACKS]=engine.ratchets;
+sequencer (&velocities)[NTRACKS]=engine.velocities;
+sequencer (&probability)[NTRACKS]=engine.probability;
+sequencer (&mods)[NTRACKS]=engine.mods;
+int16_t (&MIDIchannel)[NTRACKS]=engine.MIDIchannel;
+int16_t (&trackenabled)[NTRACKS]=engine.trackenabled;
+int16_t (&CCchannel)[NTRACKS]=engine.CCchannel;
+int16_t (&mod_enabled)[NTRACKS]=engine.mod_enabled;
+int16_t (&current_scale)[NTRACKS]=engine.current_scale;
+int16_t (&quantmode)[NTRACKS]=engine.quantmode;
+int16_t (&seed)[NTRACKS]=engine.seed;
+int16_t (&lockseed)[NTRACKS]=engine.lockseed;
+
+// all the sequencer arrays by lane - order matches the graphic UI pages
+enum LANES {LANE_NOTES,LANE_GATES,LANE_VELOCITIES,LANE_OFFSETS,LANE_PROBABILITY,LANE_RATCHETS,LANE_MODS,LANE_PARAM};
+#define NLANES LANE_PARAM
+sequencer * lanes[NLANES] = {notes,gates,velocities,offsets,probability,ratchets,mods};
+
+// pattern banks
+// step values are double buffered. core 1 plays bank livebank, core 0 edits bank editbank
+// single step edits are written to the edit bank and queued for core 1 to write to the live bank
+// bulk changes (euclidean fills etc) are built in the edit bank and published with one bank swap on a tick boundary
+// so core 1 never plays a half finished pattern and never has to be stopped
+volatile uint8_t livebank=0; // only core 1 changes this
+uint8_t editbank=1;  // only core 0 changes this
+volatile bool swaprequest; // core 0 has published the edit bank
+spin_lock_t *banklock; // makes publish and swap atomic with the parameter queue
+
+// UI edits are not written directly - core 0 queues them and core 1 applies them on every loop1() pass and again at the start
+// of a clock tick so core 1 never has to be idled by the UI
+// sequencer fields are addressed by lane, track, step and field. menu parameters are plain int16 pointers so they use LANE_PARAM
+
+enum FIELDS {FIELD_VAL,FIELD_LAST};
+
+struct paramchange {
+  uint8_t lane;   // LANE_NOTES etc or LANE_PARAM
+  uint8_t track;
+  uint8_t step;   // step for FIELD_VAL
+  uint8_t field;  // FIELD_VAL etc
+  int16_t value;  // new value
+  int16_t *param; // parameter to change when lane is LANE_PARAM
+  uint32_t time;  // time_us_32() when it was queued - for latency stats
 };
 
-// velocities have MIDI values 0-127 
-sequencer velocities[NTRACKS] = {
-  22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,  // initial setting ~ 80% velocity
-  VELOCITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,  // initial setting ~ 80% velocity
-  VELOCITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,  // initial setting ~ 80% velocity
-  VELOCITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-
-  22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,22,  // initial setting ~ 80% velocity
-  VELOCITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, //  euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  60,   // root note
-};
+#define PARAMQUEUE_SIZE 128
+SPSCQueue<paramchange,PARAMQUEUE_SIZE> paramqueue;
+uint32_t paramlatency;  // us the last change sat in the queue
+uint32_t paramlatency_max; // worst case
+uint32_t paramqueue_stalls;  // times core 0 waited for room in the queue
+
+// cycle cache - see cycle.h. core 1 plays a deterministic pattern from the cache until anything changes
+// the lanes aren't stepped while the cache plays. they catch up every CYCLE_CATCHUP ticks so the playheads move
+#define CYCLE_CATCHUP (PPQN/4)
+volatile bool cycle_valid;
+uint16_t cycle_period;  // ticks in the cached cycle
+uint16_t cycle_pos;  // core 1 - tick of the cycle to play next, counted from the top of the pattern
+uint16_t cycle_cursor;  // core 1 - next entry to play
+uint32_t cycle_warmup;  // core 1 - ticks to play live before the cache takes over at the loop point
+uint16_t cycle_behind;  // core 1 - ticks the lanes haven't been stepped for
+bool cycle_play(long clockperiod, uint64_t ticktime);
+void lanes_catchup(void);
+
+// find the lane and track of a sequencer
+void seq_lane(sequencer *seq, uint8_t *lane, uint8_t *track) {
+  for (uint8_t l=0; l<NLANES; ++l) {
+    if ((seq >= lanes[l]) && (seq < lanes[l]+NTRACKS)) {
+      *lane=l;
+      *track=seq-lanes[l];
+      return;
+    }
+  }
+}
 
-// probability values 
-sequencer probability[NTRACKS] = {
-  9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,  // initial data 100% probability
-  PROBABILITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  0,   // holds euclidean offset in this case
-
-  9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,  // initial data
-  PROBABILITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  0,   // holds euclidean offset in this case
-
-  9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,  // initial data
-  PROBABILITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  0,   // holds euclidean offset in this case
-
-  9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,  // initial data
-  PROBABILITYRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  0,   // holds euclidean offset in this case
-};
+// core 0 - wait till the queue has room. core 1 drains it on every loop1() pass so this is at most CLOCK_POLL_US or a clock tick
+// a change can't be dropped - the edit bank already has it so the banks would disagree for good
+void queue_wait(void) {
+  if (paramqueue.count() < PARAMQUEUE_SIZE) return;
+  ++paramqueue_stalls;
+  while (paramqueue.count() >= PARAMQUEUE_SIZE) tight_loop_contents();
+}
 
-// modulation values 
-sequencer mods[NTRACKS] = {
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // initial data 
-  MODRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  16,   // CC number in this case
-
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // initial data 
-  MODRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  17,   // CC number in this case
-
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // initial data 
-  MODRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  18,   // CC number in this case
-
-  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,  // initial data 
-  MODRANGE,  // maximum value
-  0,   // step index
-  FORWARD, // step mode
-  0,     // state - used for step modes
-  0,   // first step
-  SEQ_STEPS-1,  // last step
-  SEQ_STEPS, // euclidean length
-  1, // euclidean beats
-  6,  // clock divide
-  24,    // clock counter
-  19,   // CC number in this case
-};
+// core 0 - queue a change to a sequencer field
+void queue_seqfield(sequencer *seq, uint8_t step, uint8_t field, int16_t value) {
+  paramchange pc={0,0,step,field,value,0,time_us_32()};
+  seq_lane(seq,&pc.lane,&pc.track);
+  queue_wait();
+  paramqueue.put(pc);
+}
 
+// core 0 - queue a change to a menu parameter
+void queue_param(int16_t *param, int16_t value) {
+  paramchange pc={LANE_PARAM,0,0,0,value,param,time_us_32()};
+  queue_wait();
+  paramqueue.put(pc);
+}
 
+// core 0 - current value of a menu parameter including changes core 1 hasn't applied yet
+int16_t pending_param(int16_t *param) {
+  int16_t value=*param;
+  paramchange pc;
+  for (uint16_t i=0; paramqueue.peek(i,pc); ++i) {
+    if ((pc.lane == LANE_PARAM) && (pc.param == param)) value=pc.value;
+  }
+  return value;
+}
+
+// core 0 - set up the pattern banks. both banks start out with the power up settings
+void pattern_init(void) {
+  banklock=spin_lock_instance(spin_lock_claim_unused(true));
+}
+
+// core 0 - call before editing. after core 1 has swapped in a published bank the edit bank is refreshed from it
+void pattern_sync(void) {
+  if (swaprequest || (editbank != livebank)) return;
+  editbank=livebank^1;
+  for (uint8_t l=0; l<NLANES; ++l) {
+    for (uint8_t t=0; t<NTRACKS; ++t) memcpy(lanes[l][t].val[editbank],lanes[l][t].val[livebank],sizeof(lanes[l][t].val[0]));
+  }
+}
+
+// core 0 - start a bulk change in the edit bank
+// a publish core 1 hasn't picked up yet is withdrawn so we never modify a bank while it is being swapped in
+void pattern_begin(void) {
+  uint32_t save=spin_lock_blocking(banklock);
+  swaprequest=false;
+  spin_unlock(banklock,save);
+  pattern_sync();
+}
+
+// core 0 - publish the edit bank. core 1 swaps it in on the next tick boundary
+// changes queued between pattern_lock() and pattern_publish() go live on the same tick as the new bank
+// core 1 can't drain the queue while we hold the lock so make room for them first
+uint32_t pattern_lock(void) {
+  queue_wait();
+  return spin_lock_blocking(banklock);
+}
+
+void pattern_publish(uint32_t save) {
+  swaprequest=true;
+  spin_unlock(banklock,save);
+}
+
+// true if a menu parameter changes what the lanes play - anything in the engine except the euclidean length and beats,
+// which only take effect when a fill is published. the tempo, clock source, preset slot etc don't, the cache follows the tempo
+bool param_affects_output(const int16_t *param) {
+  const uint8_t *p=(const uint8_t *)param, *e=(const uint8_t *)&engine;
+  if ((p < e) || (p >= e+sizeof(engine))) return false;
+  size_t offset=p-e;
+  if (offset >= sizeof(sequencer)*NLANES*NTRACKS) return true; // track settings
+  offset%=sizeof(sequencer);
+  return (offset != offsetof(sequencer,euclen)) && (offset != offsetof(sequencer,eucbeats));
+}
+
+// core 1 - apply all the queued changes and swap in a published pattern bank
+void apply_paramchanges(void) {
+  paramchange pc;
+  uint32_t save=spin_lock_blocking(banklock);
+  while (paramqueue.get(pc)) {
+    if (pc.lane == LANE_PARAM) *pc.param=pc.value;
+    else {
+      sequencer *seq=&lanes[pc.lane][pc.track];
+      switch (pc.field) {
+        case FIELD_VAL:
+          seq->val[livebank][pc.step]=pc.value;
+          break;
+        case FIELD_LAST:
+          seq->last=pc.value;
+          break;
+      }
+    }
+    if ((pc.lane != LANE_PARAM) || param_affects_output(pc.param)) cycle_valid=false; // the cached cycle is out of date
+    paramlatency=time_us_32()-pc.time;
+    if (paramlatency > paramlatency_max) paramlatency_max=paramlatency;
+    if (!seq_offline) TIMING_ADD(stat_paramlat,paramlatency);
+  }
+  if (swaprequest) {
+    livebank^=1;
+    swaprequest=false;
+    cycle_valid=false;
+  }
+  spin_unlock(banklock,save);
+}
+
+
+// next number from a lane's generator
+uint32_t lane_random(sequencer *seq) {
+  uint32_t x=seq->rng;
+  x^=x << 13;
+  x^=x >> 17;
+  x^=x << 5;
+  seq->rng=x;
+  return x;
+}
+
+// random number 0 to n-1 from a lane's generator - multiply and shift instead of a divide
+uint32_t lane_range(sequencer *seq, uint32_t n) {
+  return ((uint64_t)lane_random(seq)*n) >> 32;
+}
+
+// move a sequencer on to its next step
+void seqstep(sequencer *seq) {
+  switch (seq->stepmode) {
+    case FORWARD:
+      ++seq->index;
+      if (seq->index > seq->last) seq->index=seq->first;
+      break;
+    case BACKWARD:
+      --seq->index;
+      if (seq->index < seq->first) seq->index=seq->last;
+      break;
+    case PINGPONG:
+      if (seq->state == FORWARD) {
+       ++seq->index;
+        if (seq->index > seq->last) {
+          seq->index=seq->last-1;
+          seq->index=constrain(seq->index,seq->first,seq->last);
+          seq->state=BACKWARD;
+        }
+      }
+      else {
+        --seq->index;
+        if (seq->index < seq->first) {
+          seq->index=seq->first+1;
+          seq->index=constrain(seq->index,seq->first,seq->last);
+          seq->state=FORWARD;
+        }
+      }
+      break;
+      case RANDOMWALK:
+        seq->index+=(int16_t)lane_range(seq,3)-1; // range of -1 to +1
+        seq->index=constrain(seq->index,seq->first,seq->last);
+      break;
+      case RANDOM:
+        seq->index=seq->first+lane_range(seq,seq->last-seq->first+1); // any step first to last
+      break;        
+    default:
+      break;
+  }
+}
 
 // clock a sequencer
 // you have to pass a pointer to the sequence structure, not the structure itself
@@ -440,54 +376,48 @@ int16_t seqclock(sequencer *seq) {
   if (seq->clockticks < 1 ) { // divider has rolled over
     seq->clockticks=divtable[seq->divider];  // lookup table used to get clock divider
     event=1;
-    switch (seq->stepmode) {
-      case FORWARD:
-        ++seq->index;
-        if (seq->index > seq->last) seq->index=seq->first;
-        break;
-      case BACKWARD:
-        --seq->index;
-        if (seq->index < seq->first) seq->index=seq->last;
-        break;
-      case PINGPONG:
-        if (seq->state == FORWARD) {
-         ++seq->index;
-          if (seq->index > seq->last) {
-            seq->index=seq->last-1;
-            seq->index=constrain(seq->index,seq->first,seq->last);
-            seq->state=BACKWARD;
-          }
-        }
-        else {
-          --seq->index;
-          if (seq->index < seq->first) {
-            seq->index=seq->first+1;
-            seq->index=constrain(seq->index,seq->first,seq->last);
-            seq->state=FORWARD;
-          }
-        }
-        break;
-        case RANDOMWALK:
-          seq->index+=random(-1,2); // range of -1 to +1
-          seq->index=constrain(seq->index,seq->first,seq->last);
-        break;
-        case RANDOM:
-          seq->index=random(seq->first,seq->last);
-        break;        
-      default:
-        break;
-    }
+    seqstep(seq);
   }
   return event;
   //Serial.printf("ticks %d stepindex %d \n",seq->clockticks,seq->index);
 }
 
+// clock a sequencer n ticks at once - the same as n calls to seqclock()
+void lane_advance(sequencer *seq, uint32_t n) {
+  int32_t ticks=(seq->clockticks < 1) ? 1 : seq->clockticks; // ticks to the next step
+  if (n < (uint32_t)ticks) {
+    seq->clockticks=ticks-n;
+    return;
+  }
+  int32_t div=divtable[seq->divider];
+  uint32_t steps=1+(n-ticks)/div;
+  seq->clockticks=div-(n-ticks) % div;
+  while (steps--) seqstep(seq);
+}
+
+// core 1 - bring the lanes up to the tick the cache has played to
+void lanes_catchup(void) {
+  if (cycle_behind == 0) return;
+  for (uint8_t l=0; l<NLANES; ++l) {
+    for (uint8_t track=0; track<NTRACKS; ++track) lane_advance(&lanes[l][track],cycle_behind);
+  }
+  cycle_behind=0;
+}
+
 // clock all the sequencers
-// clockperiod is the period of the 24ppqn clock - used for calculating gate times etc
-// this code got a bit messy after I added multiple tracks
-// it loops thru all tracks, all sequences looking for note on and off events to process
-void clocktick (long clockperiod) {
+// clockperiod is the period of the 24ppqn clock in us - used for calculating gate times etc
+// ticktime is when this clock tick is due. note events are scheduled relative to it and sent from the event queue
+// it loops thru all tracks, all sequences looking for note on and off events to schedule
+void clocktick (long clockperiod, uint64_t ticktime) {
   int16_t gatestate,ccval;
+  TIMING_START(t);
+  apply_paramchanges(); // UI edits take effect on a tick boundary
+  if (cycle_play(clockperiod,ticktime)) { // the notes came from the cycle cache - no need to work out the lanes
+    if (++cycle_behind >= CYCLE_CATCHUP) lanes_catchup();
+    if (!seq_offline) TIMING_END(stat_clocktick,t);
+    return;
+  }
+  lanes_catchup(); // the cache was dropped - the lanes pick up from where it got to
   for (uint8_t track=0; track<NTRACKS;++track) {
 
     // a clock tick has expired so clock the sequencers
@@ -498,246 +428,163 @@ void clocktick (long clockperiod) {
     seqclock(&ratchets[track]);
     gatestate=seqclock(&gates[track]);  
 
-    // check if gate became active and if so send note on
-    if (gatestate && trackenabled[track] && (probability[track].val[probability[track].index] > random(PROBABILITYRANGE-1))) {
-      active_notelength[track]=clockperiod*gates[track].val[gates[track].index]*gates[track].divider/GATERANGE;     // calculate notelength is ms from gate length
-      if(ratchets[track].val[ratchets[track].index] >0) ratchetcnt[track]=(ratchets[track].val[ratchets[track].index]+1)*2-1; // for 1 ratchet the count is 3(noteon) 2 (noteoff) 1 (noteon) 0 (noteoff)
-      if ((active_notelength[track] > 0) && (ratchetcnt[track] > 0)) { // if we have ratchets divide up the notelength to the number of ratchets
-        active_notelength[track]=clockperiod*gates[track].divider/(ratchetcnt[track]+1); // for 1 ratchet (2 notes) divide the note time in four and send noteon/noteoff when the count changes ie 50% gate 
-      }
-      notetimer[track]=millis()+active_notelength[track];
-      if ((active_notelength[track] > 0) && (!tie[track])) {  // no note on when gate is zero or a tied note is in progress
-        active_note[track]=notes[track].val[notes[track].index]+offsets[track].val[offsets[track].index]+notes[track].root;
-        active_note[track] = constrain(active_note[track],0,127); // limit to MIDI range
-        active_note[track]= quantize(active_note[track],scales[current_scale[track]],notes[track].root); // quantize to current root and scale
-        active_velocity[track]=constrain(velocities[track].val[velocities[track].index]*VELOCITYSCALE,0,127);
-        noteOn(MIDIchannel[track]-1,active_note[track],active_velocity[track]);
-        //Serial.printf("noteon %d\n",active_note);
+    // check if gate became active and if so schedule the notes for this step
+    if (gatestate && trackenabled[track] && (probability[track].val[livebank][probability[track].index] > (int16_t)lane_range(&probability[track],PROBABILITYRANGE))) {
+      uint8_t channel=MIDIchannel[track]-1;
+      int16_t gate=gates[track].val[livebank][gates[track].index];
+      int16_t nratchets=ratchets[track].val[livebank][ratchets[track].index];
+      long steplength=clockperiod*divtable[gates[track].divider]; // step length in us
+      flush_track_events(track,ticktime); // previous step can't overlap this one
+
+      if (gate == 0) { // gate off - just end a tied note
+        if (tie[track]) schedule_event(ticktime,EVENT_NOTEOFF,track,channel,active_note[track],0);
+        tie[track]=FALSE;
       }
-      if ((gates[track].val[gates[track].index]==GATERANGE) && (ratchetcnt[track]==0)) tie[track]=TRUE; // 100% gate is a tied note, unless we are ratcheting
-      else tie[track]=FALSE;
-      //Serial.printf("notelength %d\n",notelength);
-    }
-
-    // process note offs and ratchets
-    // the code produces 50% gate time on ratchets
-    // this was hard to get right! maybe should be a state machine
-
-    if (millis() > notetimer[track]) { // if note timer has expired
-      if (active_note[track] && (!tie[track])) {
-        if (ratchetcnt[track] >0) { // we are ratcheting
-          if (ratchetcnt[track] & 1) noteOff(MIDIchannel[track]-1,active_note[track],0); // ratcheting - note off on odd ratchet counts
+      else {
+        int16_t note=notes[track].val[livebank][notes[track].index]+offsets[track].val[livebank][offsets[track].index]+notes[track].root;
+        note = constrain(note,0,127); // limit to MIDI range
+        note = quantize(note,current_scale[track],notes[track].root,quantmode[track]); // quantize to current root and scale
+        int16_t velocity=constrain(velocities[track].val[livebank][velocities[track].index]*VELOCITYSCALE,0,127);
+
+        if (nratchets == 0) {
+          if (!tie[track]) { // a tied note from the last step just keeps sounding
+            active_note[track]=note;
+            schedule_event(ticktime,EVENT_NOTEON,track,channel,note,velocity);
+          }
+          tie[track]=(gate==GATERANGE); // 100% gate is a tied note
+          if (!tie[track]) schedule_event(ticktime+steplength*gate/GATERANGE,EVENT_NOTEOFF,track,channel,active_note[track],0);
+        }
+        else { // ratchets divide the step into nratchets+1 notes with 50% gate time
+          if (tie[track]) schedule_event(ticktime,EVENT_NOTEOFF,track,channel,active_note[track],0); // end the tied note so the ratchets can retrigger
+          long slot=steplength/(nratchets+1);
+          active_note[track]=note;
+          tie[track]=(gate==GATERANGE); // a tied ratcheted step holds its last repeat into the next step
+          for (int16_t r=0; r<=nratchets; ++r) {
+            schedule_event(ticktime+slot*r,EVENT_NOTEON,track,channel,note,velocity);
+            if ((r < nratchets) || !tie[track]) schedule_event(ticktime+slot*r+slot/2,EVENT_NOTEOFF,track,channel,note,0);
+          }
         }
-        else noteOff(MIDIchannel[track]-1,active_note[track],0); // not ratcheting, turn note off
-        if (ratchetcnt[track]==0) active_note[track]=0;  // its the last ratchet
-        else notetimer[track]=millis()+active_notelength[track]; // schedule another
       }
-      if (ratchetcnt[track] && active_note[track]) {  // we are ratcheting so send another note on
-        if (!(ratchetcnt[track] &1)) noteOn(MIDIchannel[track]-1,active_note[track],active_velocity[track]); // send noteon every 2nd count
-        //Serial.printf("noteon %d\n",active_note);
-        if ((--ratchetcnt[track]) == 0) active_note[track]=0;
-      }     
     }
 
     // process mod sequencers
     gatestate=seqclock(&mods[track]); 
     if (gatestate) { // true when sequencer steps
-      ccval=mods[track].val[mods[track].index]; // get the CC value to send
+      ccval=mods[track].val[livebank][mods[track].index]; // get the CC value to send
       if ((mod_enabled[track]) && (ccval >=0) && (ccval!=lastCC[track])) { // CC value -1 means don't send anything. don't send same CC message over and over
-        controlChange(((byte)CCchannel[track])-1,(byte)mods[track].root,(byte)ccval); // in this case seq.root is the CC number
+        schedule_event(ticktime,EVENT_CC,track,((byte)CCchannel[track])-1,(byte)mods[track].root,(byte)ccval); // in this case seq.root is the CC number
         lastCC[track]=ccval;
       }
     }
   }
-}
- 
-
-// must be called regularly for sequencer to run
-void do_clocks(void) {
-  long clockperiod= (long)(((60.0/(float)bpm)/PPQN)*1000);
-  if ((millis() - clocktimer) > clockperiod) {
-    clocktimer=millis(); 
-    clocktick(clockperiod);
-  }
+  if (!seq_offline) TIMING_END(stat_clocktick,t);
 }
 
 // send noteoff for all notes
-void all_notes_off(void) {
+// the cache stays - notes were cut off so it plays live for a whole cycle and takes over again at the loop point
+void all_notes_off(uint64_t now) {
+  if (cycle_valid) cycle_warmup=cycle_period+(cycle_period-cycle_pos) % cycle_period;
+  flush_events(now); // pending note offs go out now, pending note ons are dropped
   for (uint8_t track=0; track<NTRACKS;++track) {
-    noteOff(MIDIchannel[track]-1,active_note[track],0); // turn the note off
-  }
-}
-
-// resets all clock counters and indices to get everything back in sync
-void sync_sequencers(void){
-  for (int track=0; track<NTRACKS;++track) {
-    notes[track].clockticks=divtable[notes[track].divider];  // lookup table used to get clock divider
-    notes[track].index=0;
-    gates[track].clockticks=divtable[gates[track].divider];;
-    gates[track].index=0;
-    velocities[track].clockticks=divtable[velocities[track].divider];
-    velocities[track].index=0;
-    offsets[track].clockticks=divtable[offsets[track].divider];
-    offsets[track].index=0;
-    probability[track].clockticks=divtable[probability[track].divider];
-    probability[track].index=0;
-    ratchets[track].clockticks=divtable[ratchets[track].divider];
-    ratchets[track].index=0;
+    tie[track]=FALSE;
+    seqevent ev={now,EVENT_NOTEOFF,track,(uint8_t)(MIDIchannel[track]-1),(uint8_t)active_note[track],0};
+    event_out(&ev,now); // turn the note off
   }
 }
 
-// Euclidean calculation functions from http://clsound.com/euclideansequenc.html
+// copy of everything clocktick() changes - lets core 0 run the sequencer ahead of time for benchmarks etc
+// and put it back afterwards. core 1 has to be idled with rp2040.idleOtherCore() while the copy is out
+struct seqsnapshot {
+  Engine<NTRACKS,SEQ_STEPS> engine;
+  int16_t active_note[NTRACKS];
+  bool tie[NTRACKS];
+  int16_t lastCC[NTRACKS];
+  uint8_t livebank;
+  int16_t eventcount;
+  seqevent events[EVENT_QUEUE_SIZE];
+  uint16_t cycle_pos,cycle_cursor;
+  uint32_t cycle_warmup;
+};
 
-/*Function to right rotate n by d bits*/
+seqsnapshot snapshot;
+
+void seq_save(seqsnapshot *s) {
+  lanes_catchup(); // the copy has the lanes where the pattern really is
+  s->engine=engine;
+  memcpy(s->active_note,active_note,sizeof(active_note));
+  memcpy(s->tie,tie,sizeof(tie));
+  memcpy(s->lastCC,lastCC,sizeof(lastCC));
+  s->livebank=livebank;
+  s->eventcount=eventcount;
+  memcpy(s->events,events,sizeof(events));
+  s->cycle_pos=cycle_pos;
+  s->cycle_cursor=cycle_cursor;
+  s->cycle_warmup=cycle_warmup;
+}
 
-uint16_t rightRotate(int shift, uint16_t value, uint8_t pattern_length) {
-  uint16_t mask = ((1 << pattern_length) - 1);
-  value &= mask;
-  return ((value >> shift) | (value << (pattern_length - shift))) & mask;
+void seq_restore(const seqsnapshot *s) {
+  engine=s->engine;
+  memcpy(active_note,s->active_note,sizeof(active_note));
+  memcpy(tie,s->tie,sizeof(tie));
+  memcpy(lastCC,s->lastCC,sizeof(lastCC));
+  livebank=s->livebank;
+  eventcount=s->eventcount;
+  memcpy(events,s->events,sizeof(events));
+  cycle_pos=s->cycle_pos;
+  cycle_cursor=s->cycle_cursor;
+  cycle_warmup=s->cycle_warmup;
 }
 
-// Function to find the binary length of a number by counting bitwise
-int findlength(unsigned int bnry) {
-  boolean lengthfound = false;
-  int length = 1; // no number can have a length of zero - single 0 has a length of one, but no 1s for the sytem to count
-  for (int q = 32; q >= 0; q--) {
-    int r = bitRead(bnry, q);
-    if (r == 1 && lengthfound == false) {
-      length = q + 1;
-      lengthfound = true;
+// resets all clock counters and indices to get everything back in sync
+// the cycle cache starts from the top too. the first time thru is played live since a tie or CC carried over the loop
+// point hasn't happened yet
+void sync_sequencers(void){
+  cycle_pos=0;
+  cycle_cursor=0;
+  cycle_behind=0;
+  cycle_warmup=cycle_period;
+  for (int track=0; track<NTRACKS;++track) {
+    for (uint8_t l=0; l<NLANES; ++l) {
+      lanes[l][track].clockticks=divtable[lanes[l][track].divider];  // lookup table used to get clock divider
+      lanes[l][track].index=0;
+      lanes[l][track].state=FORWARD;
     }
+    // with lock seed on the random parts of the track play the same every time, otherwise they start somewhere new
+    uint16_t trackseed=lockseed[track] ? seed[track] : seed[track]^time_us_32();
+    for (uint8_t l=0; l<NLANES; ++l) lanes[l][track].rng=seedhash(trackseed,track,l);
   }
-  return length;
 }
 
-// Function to concatenate two binary numbers bitwise
-unsigned int ConcatBin(unsigned int bina, unsigned int binb) {
-  int binb_len = findlength(binb);
-  unsigned int sum = (bina << binb_len);
-  sum = sum | binb;
-  return sum;
+// Euclidean patterns - k beats spread as evenly as possible over n steps, n up to 64
+// Bresenham style: step i is a beat when (i*k) mod n < k, so the pattern always starts with a beat
+// this gives the same rhythms as the Bjorklund algorithm (up to rotation) in one pass with no recursion or buffers
+// patterns are returned as a 64 bit mask LSB first ie bit 0 is step 0
+
+#define EUC_MAXSTEPS 64
+static_assert(SEQ_STEPS <= EUC_MAXSTEPS,"euclidean patterns are limited to 64 steps");
+
+// rotate the low n bits of a pattern left by o ie delay it by o steps
+uint64_t rotate_pattern(uint64_t pattern, int n, int o) {
+  if ((n <= 0) || (n > EUC_MAXSTEPS)) return pattern;
+  o%=n;
+  if (o == 0) return pattern;
+  uint64_t mask=(n == 64) ? ~0ULL : ((1ULL << n)-1);
+  pattern&=mask;
+  return ((pattern << o) | (pattern >> (n-o))) & mask;
 }
 
-uint16_t euclid(int n, int k, int o) { // inputs: n=total, k=beats, o = offset
-  int pauses = n - k;
-  int pulses = k;
-  int offset = o;
-  int steps = n;
-  int per_pulse = pauses / k;
-  int remainder = pauses % pulses;
-  unsigned int workbeat[n];
-  unsigned int outbeat;
-  uint16_t outbeat2;
-  unsigned int working;
-  int workbeat_count = n;
-  int a;
-  int b;
-  int trim_count;
-
-  for (a = 0; a < n; a++) { // Populate workbeat with unsorted pulses and pauses
-    if (a < pulses) {
-      workbeat[a] = 1;
-    }
-    else {
-      workbeat[a] = 0;
-    }
-  }
-
-  if (per_pulse > 0 && remainder < 2) { // Handle easy cases where there is no or only one remainer
-    for (a = 0; a < pulses; a++) {
-      for (b = workbeat_count - 1; b > workbeat_count - per_pulse - 1; b--) {
-        workbeat[a] = ConcatBin(workbeat[a], workbeat[b]);
-      }
-      workbeat_count = workbeat_count - per_pulse;
-    }
-
-    outbeat = 0; // Concatenate workbeat into outbeat - according to workbeat_count
-    for (a = 0; a < workbeat_count; a++) {
-      outbeat = ConcatBin(outbeat, workbeat[a]);
-    }
-
-    if (offset > 0) {
-      outbeat2 = rightRotate(offset, outbeat, steps); // Add offset to the step pattern
-    }
-    else {
-      outbeat2 = outbeat;
-    }
-
-    return outbeat2;
-  }
-
-  else {
-    if (pulses == 0) {
-      pulses = 1;  //	Prevent crashes when k=0 and n goes from 0 to 1
-    }
-    int groupa = pulses;
-    int groupb = pauses;
-    int iteration = 0;
-    if (groupb <= 1) {
-    }
-
-    while (groupb > 1) { //main recursive loop
-      /*Serial.print("Pulses: ");		//	Help debug crash
-        Serial.println(pulses);
-        Serial.print("Pauses: ");
-        Serial.println(pauses);
-        Serial.print("Iterations: ");
-        Serial.println(iteration);*/
-      if (groupa > groupb) { // more Group A than Group B
-        int a_remainder = groupa - groupb; // what will be left of groupa once groupB is interleaved
-        trim_count = 0;
-        for (a = 0; a < groupa - a_remainder; a++) { //count through the matching sets of A, ignoring remaindered
-          workbeat[a] = ConcatBin(workbeat[a], workbeat[workbeat_count - 1 - a]);
-          trim_count++;
-        }
-        workbeat_count = workbeat_count - trim_count;
-
-        groupa = groupb;
-        groupb = a_remainder;
-      }
-
-      else if (groupb > groupa) { // More Group B than Group A
-        int b_remainder = groupb - groupa; // what will be left of group once group A is interleaved
-        trim_count = 0;
-        for (a = workbeat_count - 1; a >= groupa + b_remainder; a--) { //count from right back through the Bs
-          workbeat[workbeat_count - a - 1] = ConcatBin(workbeat[workbeat_count - a - 1], workbeat[a]);
-
-          trim_count++;
-        }
-        workbeat_count = workbeat_count - trim_count;
-        groupb = b_remainder;
-      }
-
-      else if (groupa == groupb) { // groupa = groupb
-        trim_count = 0;
-        for (a = 0; a < groupa; a++) {
-          workbeat[a] = ConcatBin(workbeat[a], workbeat[workbeat_count - 1 - a]);
-          trim_count++;
-        }
-        workbeat_count = workbeat_count - trim_count;
-        groupb = 0;
-      }
-
-      else {
-        //Serial.println("ERROR");
-      }
-      iteration++;
-    }
-
-    outbeat = 0; // Concatenate workbeat into outbeat - according to workbeat_count
-    for (a = 0; a < workbeat_count; a++) {
-      outbeat = ConcatBin(outbeat, workbeat[a]);
-    }
-
-    if (offset > 0) {
-      outbeat2 = rightRotate(offset, outbeat, steps); // Add offset to the step pattern
-    }
-    else {
-      outbeat2 = outbeat;
-    }
-
-    return outbeat2;
+uint64_t euclid(int n, int k, int o) { // inputs: n=total, k=beats, o = offset
+  if (n > EUC_MAXSTEPS) n=EUC_MAXSTEPS;
+  if ((n <= 0) || (k <= 0)) return 0;
+  if (k > n) k=n;
+  uint64_t pattern=0;
+  int acc=0; // (i*k) mod n, updated incrementally
+  for (int i=0; i<n; ++i) {
+    if (acc < k) pattern|=1ULL << i;
+    acc+=k;
+    if (acc >= n) acc-=n;
   }
+  return rotate_pattern(pattern,n,o);
 }
 
 //------------------end euclidian math-------------------------
@@ -751,13 +598,16 @@ uint16_t euclid(int n, int k, int o) { // inputs: n=total, k=beats, o = offset
 // you can also edit the probabilities for even more variation
 
 void eucprobability(void) {
-  uint16_t pattern;
-  pattern = euclid(probability[current_track].euclen,probability[current_track].eucbeats,probability[current_track].root); // "root" is used for offset in this case
-  rp2040.idleOtherCore(); // stop core 1 while we modify sequencer values
-  probability[current_track].last=probability[current_track].euclen-1; // reset the sequence length to the euclidean length set in the menus
-  for (int i=0;i<probability[current_track].euclen;++i){  // pattern is MSB first
-    if (bitRead(pattern,probability[current_track].euclen-i-1)) probability[current_track].val[i]=PROBABILITYRANGE; // 100% probability
-    else probability[current_track].val[i]=0;  // 0% probability, same as gate off
+  uint64_t pattern;
+  sequencer *seq=&probability[current_track];
+  int16_t euclen=pending_param(&seq->euclen); // menu change that called us may still be in the queue
+  pattern = euclid(euclen,pending_param(&seq->eucbeats),pending_param(&seq->root)); // "root" is used for offset in this case
+  pattern_begin();
+  for (int i=0;i<euclen;++i){  // pattern is LSB first
+    if ((pattern >> i) & 1) seq->val[editbank][i]=PROBABILITYRANGE; // 100% probability
+    else seq->val[editbank][i]=0;  // 0% probability, same as gate off
   }
-  rp2040.resumeOtherCore();
+  uint32_t save=pattern_lock();
+  queue_seqfield(seq,0,FIELD_LAST,euclen-1); // reset the sequence length to the euclidean length set in the menus
+  pattern_publish(save);
 }
@@ -0,0 +1,54 @@
+// wait free single producer single consumer ring buffer
+// one side puts (a core or an interrupt handler), the other side gets - no locks, neither side ever waits
+// used to pass messages between the two Pico cores without idling the other core
+// SIZE must be a power of 2
+
+#include "hardware/sync.h"
+
+template <typename T, uint16_t SIZE> class SPSCQueue {
+  static_assert((SIZE & (SIZE-1)) == 0,"SPSCQueue size must be a power of 2");
+public:
+  // producer side - returns false and counts an overflow if the queue is full
+  bool put(const T &item) {
+    uint16_t h=head;
+    if ((uint16_t)(h-tail) >= SIZE) {
+      ++overflows;
+      return false;
+    }
+    buf[h & (SIZE-1)]=item;
+    __dmb(); // item has to be visible to the other core before the new head is
+    head=h+1;
+    return true;
+  }
+
+  // consumer side - returns false if the queue is empty
+  bool get(T &item) {
+    uint16_t t=tail;
+    if (t == head) return false;
+    __dmb(); // don't read the item before we have seen the head
+    item=buf[t & (SIZE-1)];
+    __dmb(); // finish reading before the slot is handed back to the producer
+    tail=t+1;
+    return true;
+  }
+
+  // producer side - look at item i of the items not consumed yet, 0 is the oldest
+  // safe because the producer is the only one that writes the slots
+  bool peek(uint16_t i, T &item) {
+    uint16_t t=tail;
+    if (i >= (uint16_t)(head-t)) return false;
+    item=buf[(t+i) & (SIZE-1)];
+    return true;
+  }
+
+  uint16_t count(void) {
+    return head-tail;
+  }
+
+  volatile uint32_t overflows=0; // items dropped because the queue was full
+
+private:
+  T buf[SIZE];
+  volatile uint16_t head=0; // written only by the producer
+  volatile uint16_t tail=0; // written only by the consumer
+};
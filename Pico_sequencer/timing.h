@@ -0,0 +1,78 @@
+// timing instrumentation - min/avg/max and a log2 histogram of how long things take, measured with the 1us RP2040 timer
+// each statistic has one writer, a core or an interrupt, and is only read by the console so no locking is needed
+// a reading printed while the writer is updating can be off by one sample - good enough for diagnostics
+// comment out TIMING_STATS to compile all of it out - the macros then expand to nothing
+
+#define TIMING_STATS
+
+#define TIMING_BUCKETS 16  // bucket n counts times of 2^(n-1) to 2^n-1 us, the last one everything longer
+
+#ifdef TIMING_STATS
+
+struct timingstat {
+  const char *name;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t hist[TIMING_BUCKETS];
+  volatile bool resetreq;  // set by the console, the writer does the reset so a sample can't be half cleared
+
+  void add(uint32_t us) {
+    if (resetreq || (count == 0)) {
+      count=0;
+      min=UINT32_MAX;
+      max=0;
+      sum=0;
+      memset(hist,0,sizeof(hist));
+      resetreq=false;
+    }
+    ++count;
+    sum+=us;
+    if (us < min) min=us;
+    if (us > max) max=us;
+    uint8_t b=32-__builtin_clz(us | 1)-((us == 0) ? 1 : 0);  // 0us in bucket 0, 1us in 1, 2-3us in 2 ...
+    if (b >= TIMING_BUCKETS) b=TIMING_BUCKETS-1;
+    ++hist[b];
+  }
+
+  void print(void) {
+    if ((count == 0) || resetreq) {
+      Serial.printf("%-10s no samples\n",name);
+      return;
+    }
+    Serial.printf("%-10s n %lu min %lu avg %lu max %lu us\n          ",name,count,min,(uint32_t)(sum/count),max);
+    for (uint8_t b=0; b<TIMING_BUCKETS-1; ++b) if (hist[b]) Serial.printf(" <%lu:%lu",1UL << b,hist[b]);
+    if (hist[TIMING_BUCKETS-1]) Serial.printf(" >=%lu:%lu",1UL << (TIMING_BUCKETS-2),hist[TIMING_BUCKETS-1]);
+    Serial.printf("\n");
+  }
+};
+
+timingstat stat_timerisr={"timerisr"};   // TimerHandler0()
+timingstat stat_encirq={"encirq"};       // step encoder scan decode
+timingstat stat_loop={"loop"};           // one pass of loop() on core 0
+timingstat stat_loop1={"loop1"};         // one pass of loop1() on core 1 not counting the sleep
+timingstat stat_clocktick={"clocktick"}; // clocktick() run time
+timingstat stat_ticklate={"ticklate"};   // how late clocktick() started against its lookahead deadline
+timingstat stat_eventlate={"eventlate"}; // how late MIDI events were sent against their timestamps
+timingstat stat_frame={"frame"};         // time to send a display frame
+timingstat stat_enclat={"enclat"};       // step encoder event to UI handling
+timingstat stat_paramlat={"paramlat"};   // UI edit to core 1 applying it
+timingstat stat_translat={"translat"};   // MIDI transport message to acting on it
+
+timingstat *const timingstats[]={&stat_timerisr,&stat_encirq,&stat_loop,&stat_loop1,&stat_clocktick,&stat_ticklate,
+  &stat_eventlate,&stat_frame,&stat_enclat,&stat_paramlat,&stat_translat};
+
+#define NTIMINGSTATS (sizeof(timingstats)/sizeof(timingstat *))
+
+#define TIMING_START(t) uint32_t t=time_us_32()
+#define TIMING_END(stat,t) stat.add(time_us_32()-(t))
+#define TIMING_ADD(stat,us) stat.add(us)
+
+#else
+
+#define TIMING_START(t)
+#define TIMING_END(stat,t)
+#define TIMING_ADD(stat,us)
+
+#endif
@@ -0,0 +1,107 @@
+// benchmarks of the sequencer engine, encoder decoders and drawing routines - run with seqhost bench [name]
+// each benchmark is run with more and more iterations until it takes at least bench_min_us, then the time per call
+// is reported like Google Benchmark does. runs on the host so the numbers compare builds and algorithms, not the
+// RP2040 - the Pico is roughly 20 to 50 times slower
+
+#define BENCH_MIN_US 200000  // default minimum run time of a benchmark
+#define BENCH_TICKTIME 1000000  // virtual time of the first clock tick
+
+volatile int32_t bench_sink;  // results go here so the compiler can't optimize the calls away
+uint32_t bench_min_us=BENCH_MIN_US;
+const char *bench_filter="";  // only run benchmarks with this in their name
+
+// run code(i) for i=0... and report the average time per call
+template<typename F> void bench(const char *name, F code) {
+  if (!strstr(name,bench_filter)) return;
+  uint64_t iters=1;
+  while (true) {
+    uint64_t start=time_us_64();
+    for (uint64_t i=0; i<iters; ++i) code((uint32_t)i);
+    uint64_t us=time_us_64()-start;
+    if (us >= bench_min_us) {
+      printf("%-24s %12llu %12.1f ns\n",name,(unsigned long long)iters,(double)us*1000/iters);
+      return;
+    }
+    uint64_t next=(us == 0) ? iters*100 : iters*bench_min_us*14/(us*10);  // aim 40% over so the next run is usually the last
+    if (next > iters*100) next=iters*100;
+    iters=(next > iters) ? next : iters+1;
+  }
+}
+
+// quadrature scans of 16 encoders spinning at random - a pattern that repeats every BENCH_SCANS scans
+#define BENCH_SCANS 256
+
+uint32_t bench_scans[BENCH_SCANS][NENC];
+
+void bench_makescans(void) {
+  uint32_t phase[NENC]={0},rng=12345;
+  for (uint16_t s=0; s<BENCH_SCANS; ++s) {
+    for (uint8_t i=0; i<NENC; ++i) {
+      rng^=rng << 13;
+      rng^=rng >> 17;
+      rng^=rng << 5;
+      phase[i]+=(rng % 3)-1;  // random walk thru the quadrature states
+      uint8_t gray=(phase[i] & 3) ^ ((phase[i] & 3) >> 1);
+      bench_scans[s][i]=~(((gray & 2) ? ENCSCAN_A : 0) | ((gray & 1) ? ENCSCAN_B : 0) | ((rng & 0x100) ? ENCSCAN_SW : 0));
+    }
+  }
+}
+
+void seq_bench(void) {
+  printf("%-24s %12s %12s\n","benchmark","iterations","time/call");
+  host_pattern();
+  seq_offline=true;
+
+  bench("clocktick",[](uint32_t i) {
+    eventcount=0; // events are thrown away each tick
+    clocktick(20833,BENCH_TICKTIME+(uint64_t)i*20833); // 120 BPM
+  });
+  event_capture=[](const seqevent *ev, uint64_t sent) { bench_sink+=ev->data1+(int32_t)sent; };
+  bench("schedule+dispatch",[](uint32_t i) { // one note on and off through the event heap
+    uint64_t t=BENCH_TICKTIME+(uint64_t)i*1000;
+    schedule_event(t,EVENT_NOTEON,i % NTRACKS,0,60,100);
+    schedule_event(t+500,EVENT_NOTEOFF,i % NTRACKS,0,60,0);
+    dispatch_events(t+500);
+  });
+  event_capture=0;
+
+  static sequencer s;
+  s=notes[0];
+  s.divider=0; // step on every other tick
+  s.stepmode=FORWARD;
+  bench("seqclock fwd",[](uint32_t i) { (void) i; bench_sink+=seqclock(&s); });
+  s.stepmode=RANDOM;
+  bench("seqclock rand",[](uint32_t i) { (void) i; bench_sink+=seqclock(&s); });
+
+  bench("quantize",[](uint32_t i) { bench_sink+=quantize(i & 127,(i >> 7) % NALLSCALES,60,(i >> 4) % NQUANTMODES); });
+  bench("euclid",[](uint32_t i) { bench_sink+=(int32_t)euclid(SEQ_STEPS,i % (SEQ_STEPS+1),i % SEQ_STEPS); });
+
+  // the 16 step encoders decoded one ClickEncoder at a time against the bitmask decoder - per scan of all 16
+  bench_makescans();
+  alignas(ClickEncoder) static uint8_t storage[NENC*sizeof(ClickEncoder)];
+  static ClickEncoder *e=(ClickEncoder *)storage;
+  for (uint8_t i=0; i<NENC; ++i) new (&e[i]) ClickEncoder(ENCA_IN,ENCB_IN,ENCSW_IN,ENCDIVIDE);
+  bench("encoder decode",[](uint32_t s) {
+    uint32_t *scan=bench_scans[s % BENCH_SCANS];
+    bool tick=((s % (ENCSCAN_HZ/1000)) == 0);
+    for (uint8_t i=0; i<NENC; ++i) {
+      uint8_t addr=NENC-1-i;
+      e[addr].decode(!(scan[i] & ENCSCAN_A),!(scan[i] & ENCSCAN_B));
+      if (tick) e[addr].tick(!(scan[i] & ENCSCAN_SW));
+    }
+  });
+  static EncoderBank bank={};
+  bank.events=false;  // scratch encoders must not feed the UI
+  bench("encoder bank decode",[](uint32_t s) {
+    uint16_t a,b,sw;
+    encscan_pack(bench_scans[s % BENCH_SCANS],a,b,sw);
+    bank.decode(e,a,b);
+    if ((s % (ENCSCAN_HZ/1000)) == 0) bank.tick(e,sw);
+  });
+
+  display.begin(SH1106_SWITCHCAPVCC);
+  display.setRotation(2);
+  bench("drawnotes",[](uint32_t i) { drawnotes(notes[i % NTRACKS]); });
+  bench("drawbars",[](uint32_t i) { drawbars(gates[i % NTRACKS]); });
+  bench("display",[](uint32_t i) { display.fillScreen(i & 1); display.display(); display.wait(); }); // full screen frames
+}
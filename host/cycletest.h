@@ -0,0 +1,120 @@
+// cycle cache check - seqhost cycle [ticks]
+// the test pattern is played live, from the cache, and from the cache dropped part way so the lanes have to catch up
+// and take over. they all have to send exactly the same events and leave every lane on the same step. then both are
+// stopped and restarted part way and synced later - the cache has to carry on thru both
+
+#define CYCLETEST_TICKS 9600  // default run length - 100 bars
+#define CYCLETEST_START_US 1000000  // time of the first tick
+#define CYCLETEST_MAXEVENTS 65536
+
+struct cycletestevent {
+  uint64_t time;
+  uint8_t type,track,channel,data1,data2;
+};
+
+struct cycletestlane {
+  int16_t index,state,clockticks;
+};
+
+// run 0 is live, run 1 the one being checked against it
+cycletestevent cycletest_log[2][CYCLETEST_MAXEVENTS];
+uint32_t cycletest_count[2];
+cycletestlane cycletest_lanes[2][NLANES][NTRACKS];  // where the lanes finished
+uint8_t cycletest_run;
+bool cycletest_kept;  // the cache was still there at the end of the run
+seqsnapshot cycletest_start;
+
+void cycletest_capture(const seqevent *ev, uint64_t now) {
+  uint32_t &n=cycletest_count[cycletest_run];
+  if (n < CYCLETEST_MAXEVENTS) cycletest_log[cycletest_run][n]={now,ev->type,ev->track,ev->channel,ev->data1,ev->data2};
+  ++n;
+}
+
+// play ticks from the start state, cached or not. the cache is dropped at tick drop, all notes are turned off at tick
+// stop and the lanes are synced at tick sync. returns false if it couldn't be cached
+bool cycletest_play(uint8_t run, uint32_t ticks, bool cache, uint32_t drop, uint32_t stop, uint32_t sync) {
+  seq_restore(&cycletest_start);
+  cycletest_run=run;
+  cycletest_count[run]=0;
+  if (cache) {
+    char buf[20];
+    uint64_t p=cycle_build();
+    cycle_describe(buf,sizeof(buf),p);
+    if (!cycle_valid) {
+      printf("can't cache the test pattern - %s\n",buf);
+      return false;
+    }
+  }
+  long clockperiod=CLOCK_US_PER_BPM/bpm;
+  event_capture=cycletest_capture;
+  for (uint32_t n=0; n<ticks; ++n) {
+    uint64_t t=CYCLETEST_START_US+(uint64_t)n*clockperiod;
+    if (n == drop) cycle_valid=false;
+    if (n == stop) all_notes_off(t);
+    if (n == sync) sync_sequencers();
+    clocktick(clockperiod,t);
+    dispatch_events(t+clockperiod-1);
+  }
+  dispatch_events(UINT64_MAX);
+  event_capture=0;
+  cycletest_kept=cycle_valid;
+  cycle_valid=false;
+  lanes_catchup();
+  for (uint8_t l=0; l<NLANES; ++l) {
+    for (uint8_t t=0; t<NTRACKS; ++t) cycletest_lanes[run][l][t]={lanes[l][t].index,lanes[l][t].state,lanes[l][t].clockticks};
+  }
+  return true;
+}
+
+// check a run against the live one
+bool cycletest_compare(const char *name) {
+  bool pass=(cycletest_count[1] == cycletest_count[0]) && (cycletest_count[0] <= CYCLETEST_MAXEVENTS);
+  if (!pass) printf("%s: %u events, %u live\n",name,cycletest_count[1],cycletest_count[0]);
+  for (uint32_t i=0; pass && (i<cycletest_count[0]); ++i) {
+    const cycletestevent &a=cycletest_log[0][i],&b=cycletest_log[1][i];
+    if ((a.time != b.time) || (a.type != b.type) || (a.track != b.track) || (a.channel != b.channel) || (a.data1 != b.data1) || (a.data2 != b.data2)) {
+      printf("%s: event %u at %llu type %d track %d %d %d, live at %llu type %d track %d %d %d\n",name,i,
+        (unsigned long long)b.time,b.type,b.track,b.data1,b.data2,(unsigned long long)a.time,a.type,a.track,a.data1,a.data2);
+      pass=false;
+    }
+  }
+  for (uint8_t l=0; l<NLANES; ++l) {
+    for (uint8_t t=0; t<NTRACKS; ++t) {
+      const cycletestlane &a=cycletest_lanes[0][l][t],&b=cycletest_lanes[1][l][t];
+      if ((a.index == b.index) && (a.state == b.state) && (a.clockticks == b.clockticks)) continue;
+      printf("%s: lane %d track %d at step %d tick %d, live at step %d tick %d\n",name,l,t+1,b.index,b.clockticks,a.index,a.clockticks);
+      pass=false;
+    }
+  }
+  printf("%-24s %u events, %u ticks from the cache %s\n",name,cycletest_count[1],cycle_ticks,pass ? "ok" : "FAILED");
+  return pass;
+}
+
+// play the test pattern all three ways - false if the cache plays anything different
+bool cycletest(uint32_t ticks) {
+  host_pattern();
+  for (uint8_t t=0; t<NTRACKS; ++t) { // shorter lanes so the pattern repeats in 4 bars and fits in the cache
+    notes[t].last=(notes[t].stepmode == PINGPONG) ? 4 : 7;
+    offsets[t].last=3;
+    velocities[t].last=3;
+    ratchets[t].last=7;
+    mods[t].last=3;
+  }
+  sync_sequencers();
+  seq_save(&cycletest_start);
+  char buf[20];
+  cycle_describe(buf,sizeof(buf),pattern_period());
+  printf("test pattern repeats every %s, %u ticks played\n",buf,ticks);
+  uint32_t stop=ticks/3+CYCLE_CATCHUP/2,sync=ticks*2/3+7;  // part way thru a cycle and a catch up
+  cycletest_play(0,ticks,false,UINT32_MAX,UINT32_MAX,UINT32_MAX);
+  bool pass=cycletest_play(1,ticks,true,UINT32_MAX,UINT32_MAX,UINT32_MAX) && cycletest_compare("cached");
+  pass=cycletest_play(1,ticks,true,ticks/2+CYCLE_CATCHUP/2,UINT32_MAX,UINT32_MAX) && cycletest_compare("cache dropped") && pass; // lanes part way behind
+  cycletest_play(0,ticks,false,UINT32_MAX,stop,sync);
+  pass=cycletest_play(1,ticks,true,UINT32_MAX,stop,sync) && cycletest_compare("stopped and synced") && pass;
+  if (!cycletest_kept) {
+    printf("stop or sync dropped the cache - FAILED\n");
+    pass=false;
+  }
+  seq_restore(&cycletest_start);
+  return pass;
+}
@@ -0,0 +1,33 @@
+// test pattern for the host programs - every track and mod lane on, lanes of different lengths and clock rates,
+// ties, ratchets and CCs so clocktick() does all of its work. no random step modes or probabilities so it is periodic
+// and plays the same on every run
+
+void host_pattern(void) {
+  for (uint8_t t=0; t<NTRACKS; ++t) {
+    for (uint8_t b=0; b<2; ++b) {
+      for (uint8_t s=0; s<SEQ_STEPS; ++s) {
+        notes[t].val[b][s]=((s*5+t*3) % (2*NOTERANGE+1))-NOTERANGE;
+        offsets[t].val[b][s]=(s % 4 == 3) ? 7 : 0;
+        gates[t].val[b][s]=(s*3+t) % (GATERANGE+1);  // 0 is a rest, GATERANGE a tie
+        velocities[t].val[b][s]=12+(s*7+t) % (VELOCITYRANGE-12);
+        ratchets[t].val[b][s]=((s+t) % 5 == 0) ? 1+(s % RATCHETRANGE) : 0;
+        mods[t].val[b][s]=(s*9+t*20) % (MODRANGE+1);
+      }
+    }
+    notes[t].last=SEQ_STEPS-1-t;  // 16, 15, 14 and 13 steps
+    offsets[t].last=5+t;
+    gates[t].last=SEQ_STEPS-1;
+    velocities[t].last=6;
+    ratchets[t].last=9;
+    mods[t].last=3+t;
+    gates[t].divider=(t < 2) ? 6 : 4;  // quarter and eighth note steps
+    notes[t].divider=gates[t].divider;
+    offsets[t].divider=8;
+    notes[t].stepmode=(t == 3) ? PINGPONG : FORWARD;
+    current_scale[t]=1+t;
+    trackenabled[t]=1;
+    mod_enabled[t]=1;
+    lockseed[t]=1;  // same random numbers on every sync
+  }
+  sync_sequencers();
+}
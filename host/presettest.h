@@ -0,0 +1,66 @@
+// preset save check - seqhost preset
+// saves the test pattern while playing into a slot that still needs erasing. nothing may touch the flash until the
+// sequencer has been stopped for PRESET_ERASE_DELAY_MS, and no page may be programmed while a clock tick is due or while
+// following MIDI clock. the save then has to load back unchanged
+
+#define PRESETTEST_POLLS 100  // loop() passes to watch for a write that shouldn't happen
+
+// bytes of a slot that are programmed - 0 if it is erased
+uint32_t presettest_used(uint8_t slot) {
+  const uint8_t *p=(const uint8_t *)preset_at(slot);
+  uint32_t n=0;
+  for (uint32_t i=0; i<PRESET_SLOTSIZE; ++i) if (p[i] != 0xff) ++n;
+  return n;
+}
+
+bool presettest_fail(const char *why) {
+  printf("preset save: %s - FAILED\n",why);
+  controlstate=IDLE;
+  return false;
+}
+
+bool presettest(void) {
+  preset_init();
+  if (preset_copies == 0) return presettest_fail("no flash for presets");
+  host_pattern();
+  useMIDIclock=0;
+  uint8_t slot=preset_nextslot[0];
+  *(uint8_t *)preset_at(slot)=0;  // an old copy nobody erased ahead of time - the host flash is plain memory
+  preset_dirty|=1UL << slot;
+
+  controlstate=RUNNING;
+  nextclock=time_us_64()+1000000;
+  if (!preset_save(0) || !preset_waiting) return presettest_fail("didn't wait for the erase");
+  for (uint16_t i=0; i<PRESETTEST_POLLS; ++i) preset_poll();
+  if (presettest_used(slot) != 1) return presettest_fail("flash written while playing");
+
+  controlstate=IDLE;
+  preset_poll();
+  if (presettest_used(slot) != 1) return presettest_fail("erased right after the stop");
+  preset_busy=millis()-PRESET_ERASE_DELAY_MS;  // stopped for long enough
+  uint16_t polls=0;
+  while (preset_waiting && (polls++ < PRESETTEST_POLLS)) preset_poll();  // a sector per pass
+  if (preset_waiting || (presettest_used(slot) != 0)) return presettest_fail("not erased once stopped");
+
+  controlstate=RUNNING;
+  nextclock=time_us_64()+CLOCK_LOOKAHEAD_US+PRESET_GAP_US/2;  // a tick is due inside the gap
+  for (uint16_t i=0; i<PRESETTEST_POLLS; ++i) preset_poll();
+  if (presettest_used(slot) != 0) return presettest_fail("page programmed with a tick due");
+  nextclock=time_us_64()+1000000;
+  useMIDIclock=1;
+  for (uint16_t i=0; i<PRESETTEST_POLLS; ++i) preset_poll();
+  useMIDIclock=0;
+  if (presettest_used(slot) != 0) return presettest_fail("page programmed while following MIDI clock");
+  eventcount=0;
+  polls=0;
+  while (preset_saving && (polls++ < PRESETTEST_POLLS)) preset_poll();
+  controlstate=IDLE;
+  if (preset_saving) return presettest_fail("didn't finish in a quiet gap");
+
+  seqsnapshot saved;
+  seq_save(&saved);
+  notes[0].val[livebank][0]^=1;
+  if (!preset_load(0) || (memcmp(&saved.engine,&engine,sizeof(engine)) != 0)) return presettest_fail("didn't load back the same");
+  printf("preset save: %u pages after the stop, in quiet gaps - ok\n",(unsigned)PRESET_PAGES);
+  return true;
+}
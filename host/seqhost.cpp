@@ -0,0 +1,95 @@
+// Linux host build of the sequencer - the whole sketch compiled against the shims in host/shims
+// runs the parts that don't need the hardware: the engine, the event queue, the clock and the drawing code
+// seqhost bench [name] [min ms]   benchmarks, optionally only those with name in their name
+// seqhost sim [ticks] [jitter us] [bpm] [dump]   clock and MIDI timing simulation - exits with 1 if a check fails
+// seqhost render [bars] [file]   render the test pattern to a Standard MIDI File, render.mid if no file is given
+// seqhost cycle [ticks]   check the cycle cache plays the test pattern the same as live - exits with 1 if not
+// seqhost preset   check a preset saved while playing waits for the stop and quiet gaps - exits with 1 if not
+
+#include <new>
+#include "Pico_sequencer.ino"
+#include "pattern.h"
+#include "bench.h"
+#include "sim.h"
+#include "cycletest.h"
+#include "presettest.h"
+
+FILE *render_file;
+
+void render_write(uint8_t b) {
+  fputc(b,render_file);
+}
+
+// render to a file and check it is as long as its chunk headers say
+bool host_render(uint32_t bars, const char *name) {
+  render_file=fopen(name,"wb");
+  if (!render_file) {
+    printf("can't write %s\n",name);
+    return false;
+  }
+  render_out=render_write;
+  uint64_t start=time_us_64();
+  uint32_t size=render_smf(bars);
+  uint64_t us=time_us_64()-start;
+  long written=ftell(render_file);
+  bool ok=(fclose(render_file) == 0) && (written == (long)size);
+  if (bars > RENDER_MAXBARS) bars=RENDER_MAXBARS;
+  uint32_t seconds=(uint64_t)bars*4*60/bpm;
+  printf("%u bars at %d BPM (%u:%02u:%02u) rendered to %s in %llu ms, %u bytes%s\n",bars,bpm,seconds/3600,seconds/60 % 60,seconds % 60,
+    name,(unsigned long long)us/1000,size,ok ? "" : " - FAILED");
+  return ok;
+}
+
+// the parts of setup() the host programs need - no display, encoders or USB
+void host_setup(void) {
+  pattern_init();
+  initmenus();
+  clock_init();
+}
+
+void usage(void) {
+  printf("usage: seqhost bench [name] [min ms]\n"
+         "       seqhost sim [ticks] [jitter us] [bpm] [dump]\n"
+         "       seqhost render [bars] [file]\n"
+         "       seqhost cycle [ticks]\n"
+         "       seqhost preset\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 2;
+  }
+  host_setup();
+  if (strcmp(argv[1],"bench") == 0) {
+    if (argc > 2) bench_filter=argv[2];
+    if (argc > 3) bench_min_us=strtoul(argv[3],0,10)*1000;
+    seq_bench();
+    return 0;
+  }
+  if (strcmp(argv[1],"sim") == 0) {
+    uint32_t arg[3]={SIM_TICKS,SIM_JITTER_US,TEMPO};
+    bool dump=false;
+    for (int i=2, n=0; i<argc; ++i) {
+      if (strcmp(argv[i],"dump") == 0) dump=true;
+      else if (n < 3) arg[n++]=strtoul(argv[i],0,10);
+    }
+    host_pattern();
+    bpm=constrain(arg[2],20,240);
+    bool pass=sim_run(arg[0],arg[1]);
+    if (dump) sim_dump();
+    return pass ? 0 : 1;
+  }
+  if (strcmp(argv[1],"render") == 0) {
+    uint32_t bars=(argc > 2) ? strtoul(argv[2],0,10) : RENDER_BARS;
+    host_pattern();
+    return host_render(bars ? bars : RENDER_BARS,(argc > 3) ? argv[3] : "render.mid") ? 0 : 1;
+  }
+  if (strcmp(argv[1],"cycle") == 0) {
+    uint32_t ticks=(argc > 2) ? strtoul(argv[2],0,10) : CYCLETEST_TICKS;
+    return cycletest(ticks ? ticks : CYCLETEST_TICKS) ? 0 : 1;
+  }
+  if (strcmp(argv[1],"preset") == 0) return presettest() ? 0 : 1;
+  usage();
+  return 2;
+}
@@ -0,0 +1,138 @@
+// host build shim for the Adafruit GFX library
+// the drawing primitives are built on the driver's drawPixel(), drawFastVLine() etc the way the real library does,
+// so drawing costs and dirty regions in the display driver are about right. there is no font - a character
+// fills its 6x8 cell with the background colour and moves the cursor
+
+#pragma once
+
+#include "Arduino.h"
+
+class Adafruit_GFX : public Print {
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h), _width(w), _height(h) {}
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color)=0;
+
+  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    for (int16_t i=0; i<h; ++i) drawPixel(x,y+i,color);
+  }
+
+  virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    for (int16_t i=0; i<w; ++i) drawPixel(x+i,y,color);
+  }
+
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    for (int16_t i=x; i<x+w; ++i) drawFastVLine(i,y,h,color);
+  }
+
+  virtual void fillScreen(uint16_t color) {
+    fillRect(0,0,_width,_height,color);
+  }
+
+  virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    if (x0 == x1) {
+      if (y0 > y1) swap(y0,y1);
+      drawFastVLine(x0,y0,y1-y0+1,color);
+      return;
+    }
+    if (y0 == y1) {
+      if (x0 > x1) swap(x0,x1);
+      drawFastHLine(x0,y0,x1-x0+1,color);
+      return;
+    }
+    bool steep=abs(y1-y0) > abs(x1-x0);
+    if (steep) {
+      swap(x0,y0);
+      swap(x1,y1);
+    }
+    if (x0 > x1) {
+      swap(x0,x1);
+      swap(y0,y1);
+    }
+    int16_t dx=x1-x0,dy=abs(y1-y0),err=dx/2,ystep=(y0 < y1) ? 1 : -1;
+    for (; x0<=x1; ++x0) {
+      if (steep) drawPixel(y0,x0,color);
+      else drawPixel(x0,y0,color);
+      err-=dy;
+      if (err < 0) {
+        y0+=ystep;
+        err+=dx;
+      }
+    }
+  }
+
+  virtual void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    drawFastHLine(x,y,w,color);
+    drawFastHLine(x,y+h-1,w,color);
+    drawFastVLine(x,y,h,color);
+    drawFastVLine(x+w-1,y,h,color);
+  }
+
+  void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+    drawFastVLine(x0,y0-r,2*r+1,color);
+    for (int16_t dx=1; dx<=r; ++dx) {
+      int16_t dy=(int16_t)sqrt((double)(r*r-dx*dx));
+      drawFastVLine(x0+dx,y0-dy,2*dy+1,color);
+      drawFastVLine(x0-dx,y0-dy,2*dy+1,color);
+    }
+  }
+
+  virtual void setRotation(uint8_t r) {
+    rotation=r & 3;
+    _width=(rotation & 1) ? HEIGHT : WIDTH;
+    _height=(rotation & 1) ? WIDTH : HEIGHT;
+  }
+
+  uint8_t getRotation(void) const {
+    return rotation;
+  }
+
+  int16_t width(void) const {
+    return _width;
+  }
+
+  int16_t height(void) const {
+    return _height;
+  }
+
+  void setCursor(int16_t x, int16_t y) {
+    cursor_x=x;
+    cursor_y=y;
+  }
+
+  void setTextColor(uint16_t c) {
+    textcolor=textbgcolor=c;
+  }
+
+  void setTextColor(uint16_t c, uint16_t bg) {
+    textcolor=c;
+    textbgcolor=bg;
+  }
+
+  using Print::write;
+  size_t write(uint8_t c) override {
+    if (c == '\n') {
+      cursor_x=0;
+      cursor_y+=8;
+    }
+    else if (c != '\r') {
+      if (textbgcolor != textcolor) fillRect(cursor_x,cursor_y,6,8,textbgcolor);
+      cursor_x+=6;
+    }
+    return 1;
+  }
+
+protected:
+  const int16_t WIDTH,HEIGHT;
+  int16_t _width,_height;
+  int16_t cursor_x=0,cursor_y=0;
+  uint16_t textcolor=0xffff,textbgcolor=0xffff;
+  uint8_t rotation=0;
+
+private:
+  static void swap(int16_t &a, int16_t &b) {
+    int16_t t=a;
+    a=b;
+    b=t;
+  }
+};
@@ -0,0 +1,30 @@
+// host build shim for Adafruit TinyUSB - USB MIDI output goes to a hook the host program can set
+
+#pragma once
+
+#include "Arduino.h"
+
+extern uint32_t (*host_midi_out)(const uint8_t *buf, uint32_t len);  // takes MIDI bytes, returns how many it took. 0 throws them away
+
+inline uint32_t tud_midi_stream_write(uint8_t cable_num, const uint8_t *buffer, uint32_t bufsize) {
+  (void) cable_num;
+  return host_midi_out ? (*host_midi_out)(buffer,bufsize) : bufsize;
+}
+
+class Adafruit_USBD_MIDI : public Stream {
+public:
+  using Print::write;
+  size_t write(uint8_t b) override {
+    return tud_midi_stream_write(0,&b,1);
+  }
+  void begin(void) {}
+};
+
+class Adafruit_USBD_Device {
+public:
+  bool mounted(void) {
+    return true;
+  }
+};
+
+extern Adafruit_USBD_Device TinyUSBDevice;
@@ -0,0 +1,178 @@
+// host build shim for the Arduino Pico core - just enough of it to run the sequencer engine on Linux
+// time comes from the host steady clock, Serial goes to stdout and anything that touches pins does nothing
+// the RP2040 has 32 bit longs - printf drops the l of %lu etc so the sketch's format strings work with 64 bit longs
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+
+#include "pico_host.h"
+
+#define PI 3.1415926535897932384626433832795
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define bitRead(value,bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value,bit) ((value) |= (1UL << (bit)))
+
+inline uint32_t millis(void) {
+  return time_us_64()/1000;
+}
+
+inline uint32_t micros(void) {
+  return time_us_32();
+}
+
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+inline void pinMode(int pin, int mode) {
+  (void) pin;
+  (void) mode;
+}
+
+inline int digitalRead(int pin) {  // inputs are pulled up - buttons and encoders are never pressed
+  (void) pin;
+  return HIGH;
+}
+
+inline void digitalWrite(int pin, int value) {
+  (void) pin;
+  (void) value;
+}
+
+void randomSeed(uint32_t seed);
+long random(long howbig);
+long random(long howsmall, long howbig);
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x-in_min)*(out_max-out_min)/(in_max-in_min)+out_min;
+}
+
+inline void noInterrupts(void) {}
+inline void interrupts(void) {}
+
+class String {
+public:
+  String(const char *s="") : str(s) {}
+  String(const std::string &s) : str(s) {}
+  String operator+(const char *s) const {
+    return String(str+s);
+  }
+  const char *c_str(void) const {
+    return str.c_str();
+  }
+  size_t length(void) const {
+    return str.size();
+  }
+private:
+  std::string str;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c)=0;
+  virtual size_t write(const uint8_t *buf, size_t len) {
+    size_t n=0;
+    while (len--) n+=write(*buf++);
+    return n;
+  }
+  size_t write(const char *s) {
+    return write((const uint8_t *)s,strlen(s));
+  }
+  size_t print(const char *s) {
+    return write(s);
+  }
+  size_t print(const String &s) {
+    return write(s.c_str());
+  }
+  size_t print(char c) {
+    return write((uint8_t)c);
+  }
+  size_t print(long n) {
+    char buf[24];
+    snprintf(buf,sizeof(buf),"%ld",n);
+    return write(buf);
+  }
+  size_t print(int n) {
+    return print((long)n);
+  }
+  size_t print(unsigned long n) {
+    char buf[24];
+    snprintf(buf,sizeof(buf),"%lu",n);
+    return write(buf);
+  }
+  size_t print(unsigned int n) {
+    return print((unsigned long)n);
+  }
+  size_t println(void) {
+    return write("\n");
+  }
+  template<typename T> size_t println(T v) {
+    size_t n=print(v);
+    return n+println();
+  }
+  size_t printf(const char *format, ...);
+};
+
+class Stream : public Print {
+public:
+  virtual int available(void) {
+    return 0;
+  }
+  virtual int read(void) {
+    return -1;
+  }
+  virtual void flush(void) {}
+};
+
+// USB serial - output goes to stdout, there is no input
+class HostSerial : public Stream {
+public:
+  using Print::write;
+  size_t write(uint8_t c) override {
+    return fwrite(&c,1,1,stdout);
+  }
+  size_t write(const uint8_t *buf, size_t len) override {
+    return fwrite(buf,1,len,stdout);
+  }
+  void flush(void) override {
+    fflush(stdout);
+  }
+  void begin(unsigned long baud) {
+    (void) baud;
+  }
+  operator bool() {
+    return true;
+  }
+};
+
+extern HostSerial Serial;
+
+// there is only one core on the host - core 1 runs when the host program calls loop1() so there is nothing to park
+class RP2040 {
+public:
+  void idleOtherCore(void) {}
+  void resumeOtherCore(void) {}
+  uint32_t getCycleCount(void) {
+    return time_us_32();
+  }
+};
+
+extern RP2040 rp2040;
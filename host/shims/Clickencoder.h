@@ -0,0 +1,3 @@
+// the sketch includes the encoder library as Clickencoder.h - on a case sensitive file system that needs forwarding
+#pragma once
+#include "ClickEncoder.h"
@@ -0,0 +1,37 @@
+// host build shim for the Arduino MIDI library - nothing comes in. the host program calls the handlers directly
+
+#pragma once
+
+#define MIDI_CHANNEL_OMNI 0
+
+template<class Transport> class MidiInterface {
+public:
+  MidiInterface(Transport &t) : transport(t) {}
+  void begin(int channel) {
+    (void) channel;
+    transport.begin();
+  }
+  bool read(void) {
+    return false;
+  }
+  void setHandleClock(void (*fptr)(void)) {
+    handleClock=fptr;
+  }
+  void setHandleStart(void (*fptr)(void)) {
+    handleStart=fptr;
+  }
+  void setHandleStop(void (*fptr)(void)) {
+    handleStop=fptr;
+  }
+  void setHandleContinue(void (*fptr)(void)) {
+    handleContinue=fptr;
+  }
+  void (*handleClock)(void)=0;
+  void (*handleStart)(void)=0;
+  void (*handleStop)(void)=0;
+  void (*handleContinue)(void)=0;
+private:
+  Transport &transport;
+};
+
+#define MIDI_CREATE_INSTANCE(Type,SerialPort,Name) MidiInterface<Type> Name((Type &)SerialPort);
@@ -0,0 +1,19 @@
+// host build shim for the Pico timer interrupt library - the timer never fires
+
+#pragma once
+
+#include "Arduino.h"
+
+typedef bool (*pico_timer_callback)(struct repeating_timer *t);
+
+class RPI_PICO_Timer {
+public:
+  RPI_PICO_Timer(uint8_t timer) {
+    (void) timer;
+  }
+  bool attachInterruptInterval(unsigned long interval, pico_timer_callback callback) {
+    (void) interval;
+    (void) callback;
+    return true;
+  }
+};
@@ -0,0 +1,30 @@
+// host build shim for the Arduino SPI object - the display driver only uses it to set up the pins
+
+#pragma once
+
+#include "Arduino.h"
+
+class SPIClassRP2040 {
+public:
+  bool setCS(uint8_t pin) {
+    (void) pin;
+    return true;
+  }
+  bool setSCK(uint8_t pin) {
+    (void) pin;
+    return true;
+  }
+  bool setTX(uint8_t pin) {
+    (void) pin;
+    return true;
+  }
+  bool setRX(uint8_t pin) {
+    (void) pin;
+    return true;
+  }
+  void begin(bool hwCS=false) {
+    (void) hwCS;
+  }
+};
+
+extern SPIClassRP2040 SPI;
@@ -0,0 +1 @@
+// host build shim for the Arduino Wire library - included by the sketch but not used
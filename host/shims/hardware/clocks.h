@@ -0,0 +1,12 @@
+// host build shim for pico SDK clocks
+
+#pragma once
+
+#include "pico_host.h"
+
+enum clock_index {clk_gpout0=0,clk_gpout1,clk_gpout2,clk_gpout3,clk_ref,clk_sys,clk_peri,clk_usb,clk_adc,clk_rtc};
+
+inline uint32_t clock_get_hz(enum clock_index clk) {
+  (void) clk;
+  return 133000000;
+}
@@ -0,0 +1,118 @@
+// host build shim for pico SDK DMA
+// a transfer from memory finishes as soon as it is started and raises the channel's interrupt, so the display driver
+// runs its whole frame chain and is never busy. transfers paced by the PIO never finish - there is no PIO
+
+#pragma once
+
+#include "pico_host.h"
+#include "hardware/irq.h"
+
+#define HOST_NDMA 12
+
+enum dma_channel_transfer_size {DMA_SIZE_8=0,DMA_SIZE_16=1,DMA_SIZE_32=2};
+
+typedef struct {
+  uint32_t ctrl;
+} dma_channel_config;
+
+struct hostdma {
+  bool claimed;
+  bool irq0,irq1;  // interrupt enabled
+  bool status0,status1;  // interrupt pending
+};
+
+extern hostdma host_dma[HOST_NDMA];
+
+inline int dma_claim_unused_channel(bool required) {
+  (void) required;
+  for (int ch=0; ch<HOST_NDMA; ++ch) {
+    if (host_dma[ch].claimed) continue;
+    host_dma[ch].claimed=true;
+    return ch;
+  }
+  return -1;
+}
+
+inline dma_channel_config dma_channel_get_default_config(uint channel) {
+  (void) channel;
+  return {0};
+}
+
+inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+  (void) c;
+  (void) size;
+}
+
+inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+  (void) c;
+  (void) dreq;
+}
+
+inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+  (void) c;
+  (void) incr;
+}
+
+inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+  (void) c;
+  (void) incr;
+}
+
+inline void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits) {
+  (void) c;
+  (void) write;
+  (void) size_bits;
+}
+
+inline void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr, const volatile void *read_addr,
+                                  uint transfer_count, bool trigger) {
+  (void) channel;
+  (void) config;
+  (void) write_addr;
+  (void) read_addr;
+  (void) transfer_count;
+  (void) trigger;
+}
+
+inline void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+  (void) channel;
+  (void) trans_count;
+  (void) trigger;
+}
+
+inline void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+  host_dma[channel].irq0=enabled;
+}
+
+inline void dma_channel_set_irq1_enabled(uint channel, bool enabled) {
+  host_dma[channel].irq1=enabled;
+}
+
+inline bool dma_channel_get_irq0_status(uint channel) {
+  return host_dma[channel].status0;
+}
+
+inline bool dma_channel_get_irq1_status(uint channel) {
+  return host_dma[channel].status1;
+}
+
+inline void dma_channel_acknowledge_irq0(uint channel) {
+  host_dma[channel].status0=false;
+}
+
+inline void dma_channel_acknowledge_irq1(uint channel) {
+  host_dma[channel].status1=false;
+}
+
+inline void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count) {
+  (void) read_addr;
+  (void) transfer_count;
+  if (host_dma[channel].irq0) {
+    host_dma[channel].status0=true;
+    host_irq(DMA_IRQ_0);
+  }
+  if (host_dma[channel].irq1) {
+    host_dma[channel].status1=true;
+    host_irq(DMA_IRQ_1);
+  }
+}
@@ -0,0 +1,30 @@
+// host build shim for pico SDK flash programming
+// the filesystem area the presets use is a block of host memory set up in shims.cpp as _FS_start to _FS_end.
+// flash offsets are worked out from its address the way the sketch does on the Pico, so only their low 32 bits mean anything
+
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include "pico_host.h"
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#define XIP_BASE 0x10000000
+
+extern uint8_t _FS_start[];  // see shims.cpp
+
+// host address of a flash offset
+inline uint8_t *host_flash(uint32_t flash_offs) {
+  uint32_t start=(uint32_t)((uintptr_t)_FS_start-XIP_BASE);
+  return _FS_start+(uint32_t)(flash_offs-start);
+}
+
+inline void flash_range_erase(uint32_t flash_offs, size_t count) {
+  memset(host_flash(flash_offs),0xff,count);
+}
+
+inline void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+  uint8_t *p=host_flash(flash_offs);
+  for (size_t i=0; i<count; ++i) p[i]&=data[i];  // programming can only clear bits
+}
@@ -0,0 +1,10 @@
+// host build shim for pico SDK GPIO - outputs go nowhere
+
+#pragma once
+
+#include "pico_host.h"
+
+inline void gpio_put(uint gpio, bool value) {
+  (void) gpio;
+  (void) value;
+}
@@ -0,0 +1,29 @@
+// host build shim for pico SDK interrupts - handlers are kept so the DMA shim can call them when a transfer is done
+
+#pragma once
+
+#include "pico_host.h"
+
+#define DMA_IRQ_0 11
+#define DMA_IRQ_1 12
+#define HOST_NIRQ 32
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+typedef void (*irq_handler_t)(void);
+
+extern irq_handler_t host_irq_handlers[HOST_NIRQ];
+extern bool host_irq_enabled[HOST_NIRQ];
+
+inline void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority) {
+  (void) order_priority;
+  host_irq_handlers[num]=handler;  // one handler per interrupt is all the sketch needs
+}
+
+inline void irq_set_enabled(uint num, bool enabled) {
+  host_irq_enabled[num]=enabled;
+}
+
+// run the handler of an interrupt as if it had fired
+inline void host_irq(uint num) {
+  if (host_irq_enabled[num] && host_irq_handlers[num]) (*host_irq_handlers[num])();
+}
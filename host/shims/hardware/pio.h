@@ -0,0 +1,117 @@
+// host build shim for pico SDK PIO - programs load and state machines configure but nothing runs
+
+#pragma once
+
+#include "pico_host.h"
+
+typedef struct {
+  volatile uint32_t ctrl,fstat,fdebug,flevel;
+  volatile uint32_t txf[4];
+  volatile uint32_t rxf[4];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+
+extern pio_hw_t host_pio_hw[2];
+#define pio0 (&host_pio_hw[0])
+#define pio1 (&host_pio_hw[1])
+
+typedef struct pio_program {
+  const uint16_t *instructions;
+  uint8_t length;
+  int8_t origin;
+} pio_program_t;
+
+typedef struct {
+  uint32_t clkdiv,execctrl,shiftctrl,pinctrl;
+} pio_sm_config;
+
+enum pio_fifo_join {PIO_FIFO_JOIN_NONE=0,PIO_FIFO_JOIN_TX=1,PIO_FIFO_JOIN_RX=2};
+
+inline uint pio_add_program(PIO pio, const pio_program_t *program) {
+  (void) pio;
+  (void) program;
+  return 0;
+}
+
+inline int pio_claim_unused_sm(PIO pio, bool required) {
+  (void) pio;
+  (void) required;
+  return 0;
+}
+
+inline void pio_gpio_init(PIO pio, uint pin) {
+  (void) pio;
+  (void) pin;
+}
+
+inline int pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {
+  (void) pio;
+  (void) sm;
+  (void) pin_base;
+  (void) pin_count;
+  (void) is_out;
+  return 0;
+}
+
+inline pio_sm_config pio_get_default_sm_config(void) {
+  return {0,0,0,0};
+}
+
+inline void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count) {
+  (void) c;
+  (void) out_base;
+  (void) out_count;
+}
+
+inline void sm_config_set_in_pins(pio_sm_config *c, uint in_base) {
+  (void) c;
+  (void) in_base;
+}
+
+inline void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint push_threshold) {
+  (void) c;
+  (void) shift_right;
+  (void) autopush;
+  (void) push_threshold;
+}
+
+inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join) {
+  (void) c;
+  (void) join;
+}
+
+inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap) {
+  (void) c;
+  (void) wrap_target;
+  (void) wrap;
+}
+
+inline void sm_config_set_clkdiv(pio_sm_config *c, float div) {
+  (void) c;
+  (void) div;
+}
+
+inline void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+  (void) pio;
+  (void) sm;
+  (void) initial_pc;
+  (void) config;
+}
+
+inline void pio_sm_set_clkdiv(PIO pio, uint sm, float div) {
+  (void) pio;
+  (void) sm;
+  (void) div;
+}
+
+inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {
+  (void) pio;
+  return sm+(is_tx ? 0 : 4);
+}
+
+inline void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+  (void) pio;
+  (void) sm;
+  (void) enabled;
+}
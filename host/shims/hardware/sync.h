@@ -0,0 +1,29 @@
+// host build shim for pico SDK spin locks - the host runs both cores' code on one thread so locks never wait
+
+#pragma once
+
+#include "pico_host.h"
+
+typedef volatile uint32_t spin_lock_t;
+
+extern spin_lock_t host_spinlocks[32];
+
+inline int spin_lock_claim_unused(bool required) {
+  (void) required;
+  static int next;
+  return next++ & 31;
+}
+
+inline spin_lock_t *spin_lock_instance(uint lock_num) {
+  return &host_spinlocks[lock_num & 31];
+}
+
+inline uint32_t spin_lock_blocking(spin_lock_t *lock) {
+  *lock=1;
+  return 0;
+}
+
+inline void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) {
+  (void) saved_irq;
+  *lock=0;
+}
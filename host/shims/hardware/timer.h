@@ -0,0 +1,27 @@
+// host build shim for pico SDK hardware alarms - every deadline has already passed so core 1 never sleeps
+
+#pragma once
+
+#include "pico_host.h"
+
+typedef void (*hardware_alarm_callback_t)(uint alarm_num);
+
+inline int hardware_alarm_claim_unused(bool required) {
+  (void) required;
+  return 0;
+}
+
+inline void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback) {
+  (void) alarm_num;
+  (void) callback;
+}
+
+inline absolute_time_t from_us_since_boot(uint64_t us) {
+  return us;
+}
+
+inline bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t) {  // true means missed
+  (void) alarm_num;
+  (void) t;
+  return true;
+}
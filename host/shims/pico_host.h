@@ -0,0 +1,27 @@
+// host build shim for the pico SDK basics - types, the microsecond timer and the barrier and sleep instructions
+
+#pragma once
+
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+uint64_t time_us_64(void);  // us since the program started
+
+inline uint32_t time_us_32(void) {
+  return (uint32_t)time_us_64();
+}
+
+inline void __dmb(void) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+inline void __wfe(void) {}
+inline void __sev(void) {}
+inline void __wfi(void) {}
+inline void tight_loop_contents(void) {}
+
+struct repeating_timer {
+  int64_t delay_us;
+};
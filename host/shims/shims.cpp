@@ -0,0 +1,96 @@
+// host build shim state - the objects and functions of the Arduino core and pico SDK that can't live in the headers
+
+#include <chrono>
+#include <thread>
+#include "Arduino.h"
+#include "Adafruit_TinyUSB.h"
+#include "SPI.h"
+#include "hardware/sync.h"
+#include "hardware/irq.h"
+#include "hardware/dma.h"
+#include "hardware/spi.h"
+#include "hardware/pio.h"
+#include "hardware/flash.h"
+
+#define HOST_FS_SIZE (256*1024)  // flash set aside for the filesystem - what the IDE Flash Size option picks on the Pico
+
+HostSerial Serial;
+RP2040 rp2040;
+Adafruit_USBD_Device TinyUSBDevice;
+SPIClassRP2040 SPI;
+uint32_t (*host_midi_out)(const uint8_t *buf, uint32_t len);
+spin_lock_t host_spinlocks[32];
+irq_handler_t host_irq_handlers[HOST_NIRQ];
+bool host_irq_enabled[HOST_NIRQ];
+hostdma host_dma[HOST_NDMA];
+spi_hw_t host_spi_hw;
+pio_hw_t host_pio_hw[2];
+
+// the filesystem area. the sketch finds it from the linker symbols _FS_start and _FS_end so they are set to the ends of the array
+alignas(FLASH_SECTOR_SIZE) uint8_t host_fs[HOST_FS_SIZE];
+asm(".globl _FS_start\n"
+    ".set _FS_start,host_fs\n"
+    ".globl _FS_end\n"
+    ".set _FS_end,host_fs+262144\n");
+static_assert(HOST_FS_SIZE == 262144,"keep the _FS_end symbol in step with HOST_FS_SIZE");
+
+struct hostfsinit {  // flash starts out erased
+  hostfsinit() {
+    memset(host_fs,0xff,sizeof(host_fs));
+  }
+} host_fs_init;
+
+static const std::chrono::steady_clock::time_point host_start=std::chrono::steady_clock::now();
+
+uint64_t time_us_64(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-host_start).count();
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+static uint32_t host_rng=1;  // xorshift - same numbers every run unless randomSeed() is called
+
+void randomSeed(uint32_t seed) {
+  if (seed) host_rng=seed;
+}
+
+long random(long howbig) {
+  if (howbig <= 0) return 0;
+  host_rng^=host_rng << 13;
+  host_rng^=host_rng >> 17;
+  host_rng^=host_rng << 5;
+  return host_rng % howbig;
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return random(howbig-howsmall)+howsmall;
+}
+
+// the sketch's format strings are written for 32 bit longs - %lu with a uint32_t etc. drop the l so the arguments
+// are read as ints. a long that fits in 32 bits still prints right since only its low half is read. %ll is left alone
+size_t Print::printf(const char *format, ...) {
+  char fmt[256];
+  size_t n=0;
+  for (const char *p=format; *p && (n < sizeof(fmt)-1); ++p) {
+    fmt[n++]=*p;
+    if (*p != '%') continue;
+    while (p[1] && strchr("-+ #0123456789.*",p[1]) && (n < sizeof(fmt)-1)) fmt[n++]=*++p;  // flags, width and precision
+    if ((p[1] == 'l') && (p[2] != 'l')) ++p;
+  }
+  fmt[n]=0;
+  char buf[512];
+  va_list args;
+  va_start(args,format);
+  int len=vsnprintf(buf,sizeof(buf),fmt,args);
+  va_end(args);
+  if (len < 0) return 0;
+  if ((size_t)len >= sizeof(buf)) len=sizeof(buf)-1;
+  return write((const uint8_t *)buf,len);
+}
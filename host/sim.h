@@ -0,0 +1,178 @@
+// virtual time simulator for the core 1 timing path - seqhost sim [ticks] [jitter us] [bpm] [dump]
+// drives do_clocks() and dispatch_events() from a made up microsecond clock instead of the timer. loop1() passes come
+// when core 1 would wake up plus a random delay, like interrupts and USB work delay it on the real thing
+// every MIDI event is captured with its virtual send time instead of going out and checked against the ideal clock grid
+// same pattern, tempo and jitter always give the same result so runs can be compared between builds
+// runs headless on the host and exits with an error if any check fails, so ctest can gate a release on it
+
+#define SIM_TICKS 960  // default run length - 40 beats
+#define SIM_JITTER_US 50  // default max random delay of a loop1() pass
+#define SIM_START_US 1000000  // virtual time of the first tick
+#define SIM_DRAIN_US 5000000  // time allowed after the last tick for note offs to go out
+#define SIM_CAPTURE 64  // events kept for dump
+
+// release limits - a run fails if any of these are exceeded
+#define SIM_MAX_DRIFT_US 1  // clock against the ideal grid at the end of the run
+#define SIM_MAX_TICKERR_US 1  // any tick against the ideal grid
+// event lateness, note length and spacing errors may not be larger than the simulated loop jitter
+
+struct simstat {
+  int32_t min,max;
+  int64_t sum;
+  uint32_t count;
+
+  void add(int32_t v) {
+    if ((count == 0) || (v < min)) min=v;
+    if ((count == 0) || (v > max)) max=v;
+    sum+=v;
+    ++count;
+  }
+
+  int32_t absmax(void) {
+    return (-min > max) ? -min : max;
+  }
+
+  void print(const char *name) {
+    if (count == 0) printf("%-16s none\n",name);
+    else printf("%-16s n %u min %d avg %d max %d us\n",name,count,min,(int32_t)(sum/count),max);
+  }
+};
+
+struct simrecord {
+  uint64_t sent;  // virtual time the event went out
+  uint64_t time;  // time it was scheduled for
+  uint8_t type,channel,data1,data2;
+};
+
+struct simtrack {
+  bool on;  // a note is sounding
+  uint8_t note;
+  uint64_t onsent,ontime;  // when the sounding note started, sent and scheduled
+  bool started;  // there has been a note on
+  uint64_t lastsent,lasttime;  // last note on sent and scheduled
+};
+
+simstat sim_late,sim_length,sim_spacing,sim_ratchet;
+simtrack sim_tracks[NTRACKS];
+simrecord sim_capture[SIM_CAPTURE];
+uint32_t sim_events,sim_overlaps;
+
+// capture an event instead of sending it
+void sim_event(const seqevent *ev, uint64_t sent) {
+  if (sim_events < SIM_CAPTURE) sim_capture[sim_events]={sent,ev->time,ev->type,ev->channel,ev->data1,ev->data2};
+  ++sim_events;
+  sim_late.add(sent-ev->time);
+  simtrack *t=&sim_tracks[ev->track];
+  switch (ev->type) {
+    case EVENT_NOTEON:
+      if (t->on) ++sim_overlaps; // the last note on the track never ended
+      if (t->started) {
+        int32_t err=(int32_t)((sent-t->lastsent)-(ev->time-t->lasttime));
+        long steplength=CLOCK_US_PER_BPM/bpm*divtable[gates[ev->track].divider];
+        if ((int64_t)(ev->time-t->lasttime) < steplength) sim_ratchet.add(err); // closer than a step - a ratchet repeat
+        else sim_spacing.add(err);
+      }
+      t->started=true;
+      t->lastsent=sent;
+      t->lasttime=ev->time;
+      t->on=true;
+      t->note=ev->data1;
+      t->onsent=sent;
+      t->ontime=ev->time;
+      break;
+    case EVENT_NOTEOFF:
+      if (t->on && (t->note == ev->data1)) {
+        sim_length.add((int32_t)((sent-t->onsent)-(ev->time-t->ontime))); // played length against scheduled length
+        t->on=false;
+      }
+      break;
+  }
+}
+
+// print a result line and count failures
+uint32_t sim_fails;
+
+void sim_check(bool pass) {
+  printf("%-16s %s\n","",pass ? "pass" : "FAIL");
+  if (!pass) ++sim_fails;
+}
+
+// run the simulation for ticks clock ticks with up to jitter us of random delay per loop1() pass
+// returns true if every check passed
+bool sim_run(uint32_t ticks, uint32_t jitter) {
+  uint32_t startoverflows=eventoverflows;
+  sim_late={};
+  sim_length={};
+  sim_spacing={};
+  sim_ratchet={};
+  memset(sim_tracks,0,sizeof(sim_tracks));
+  sim_events=0;
+  sim_overlaps=0;
+  sim_fails=0;
+  useMIDIclock=0;
+  eventcount=0;
+  event_capture=sim_event;
+  seq_offline=true;
+  uint32_t rng=12345; // same delays every run
+  uint64_t vt=SIM_START_US-CLOCK_LOOKAHEAD_US;
+  clock_start(SIM_START_US);
+  uint32_t n=0;
+  int32_t tickerr=0,drift=0;
+  while (true) {
+    dispatch_events(vt);
+    if (n < ticks) {
+      uint64_t due=nextclock;
+      do_clocks(vt);
+      if (nextclock != due) { // a tick was processed - compare it with the ideal grid
+        drift=(int32_t)(due-(SIM_START_US+(uint64_t)n*CLOCK_US_PER_BPM/bpm));
+        if (abs(drift) > tickerr) tickerr=abs(drift);
+        ++n;
+      }
+    }
+    else if ((eventcount == 0) || (vt > nextclock+SIM_DRAIN_US)) break;
+    uint64_t wake=vt+CLOCK_POLL_US; // when clock_wait() would wake core 1
+    if ((n < ticks) && (clock_due() < wake)) wake=clock_due();
+    if (next_event_time() < wake) wake=next_event_time();
+    if (wake < vt) wake=vt;
+    rng^=rng << 13;
+    rng^=rng >> 17;
+    rng^=rng << 5;
+    vt=wake+((jitter > 0) ? rng % (jitter+1) : 0);
+  }
+  uint32_t stuck=0,tied=0;
+  for (uint8_t t=0; t<NTRACKS; ++t) {
+    if (!sim_tracks[t].on) continue;
+    if (tie[t]) ++tied; // tied notes are supposed to keep sounding
+    else ++stuck;
+  }
+  uint32_t overflows=eventoverflows-startoverflows;
+  event_capture=0;
+  seq_offline=false;
+
+  printf("%u ticks at %d BPM, loop jitter up to %u us, %u events\n",n,bpm,jitter,sim_events);
+  printf("%-16s %d us max %d us\n","clock drift",drift,tickerr);
+  sim_check((abs(drift) <= SIM_MAX_DRIFT_US) && (tickerr <= SIM_MAX_TICKERR_US));
+  sim_late.print("event late");
+  sim_check((sim_late.count == 0) || ((sim_late.min >= 0) && (sim_late.max <= (int32_t)jitter)));
+  sim_length.print("note length err");
+  sim_check((sim_length.count == 0) || (sim_length.absmax() <= (int32_t)jitter));
+  sim_spacing.print("step spacing err");
+  sim_check((sim_spacing.count == 0) || (sim_spacing.absmax() <= (int32_t)jitter));
+  sim_ratchet.print("ratchet err");
+  sim_check((sim_ratchet.count == 0) || (sim_ratchet.absmax() <= (int32_t)jitter));
+  printf("%-16s stuck %u tied %u overlaps %u overflows %u\n","notes",stuck,tied,sim_overlaps,overflows);
+  sim_check((stuck == 0) && (sim_overlaps == 0) && (overflows == 0));
+  printf("%-16s %u\n","events played",sim_events);
+  sim_check(sim_events > 0); // a pattern that plays nothing passes everything
+  return sim_fails == 0;
+}
+
+// print the first captured events of the last run
+void sim_dump(void) {
+  uint32_t n=(sim_events < SIM_CAPTURE) ? sim_events : SIM_CAPTURE;
+  for (uint32_t i=0; i<n; ++i) {
+    simrecord *r=&sim_capture[i];
+    const char *type=(r->type == EVENT_NOTEON) ? "on" : (r->type == EVENT_NOTEOFF) ? "off" : "cc";
+    printf("%10llu %+5d %-3s ch %2d %3d %3d\n",(unsigned long long)r->sent,(int32_t)(r->sent-r->time),type,r->channel+1,r->data1,r->data2);
+  }
+}